@@ -0,0 +1,487 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <stddef.h>
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "desktop.h"
+#include "taskbar.h"
+#include "system.h"
+#include "defaults.h"
+#include "files.h"
+#include "history.h"
+#include "journal.h"
+#include "wallpaper.h"
+
+#include "commit.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define CONF(f) offsetof (Config, f)
+
+#define AT(conf,offset,type) ((type *) ((char *) (conf) + (offset)))
+
+/* Fields written straight away even while changes are staged - the desktop is
+ * drawn by pcmanfm from its files, and writing one of those is cheap */
+#define LIVE_FIELDS ((1 << CONF_DESKTOP) | (1 << CONF_COMMON_BG))
+
+typedef enum {
+    KIND_DESKTOPS,      /* every DesktopConfig */
+    KIND_INT,
+    KIND_STRING,
+    KIND_COLOURS        /* a light and a dark GdkRGBA */
+} FieldKind;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Each tracked field, and the writers and reloads which use its value */
+static const struct
+{
+    FieldKind kind;
+    size_t offset;
+    unsigned int actions;
+} fields[N_CONF_FIELDS] =
+{
+    [CONF_DESKTOP] =            { KIND_DESKTOPS,    0,                          W_PCMAN | R_DESKTOP },
+    [CONF_COMMON_BG] =          { KIND_INT,         CONF (common_bg),           W_PCMAN_G | R_DESKTOP },
+    [CONF_DESKTOP_FONT] =       { KIND_STRING,      CONF (desktop_font),        W_SESSION | W_PCMAN_ALL | W_QT | W_GREETER | R_SESSION | R_PANEL | R_DESKTOP | R_THEME },
+    [CONF_TERMINAL_FONT] =      { KIND_STRING,      CONF (terminal_font),       W_LXTERM },
+    [CONF_THEME_COLOUR] =       { KIND_COLOURS,     CONF (theme_colour),        W_SESSION | W_GTK3 | W_QT | R_SESSION | R_THEME },
+    [CONF_THEMETEXT_COLOUR] =   { KIND_COLOURS,     CONF (themetext_colour),    W_SESSION | W_GTK3 | W_QT | R_SESSION | R_THEME },
+    [CONF_BAR_COLOUR] =         { KIND_COLOURS,     CONF (bar_colour),          W_GTK3 | R_THEME },
+    [CONF_BARTEXT_COLOUR] =     { KIND_COLOURS,     CONF (bartext_colour),      W_GTK3 | R_THEME },
+    [CONF_ICON_SIZE] =          { KIND_INT,         CONF (icon_size),           W_PANEL | R_PANEL },
+    [CONF_TASK_WIDTH] =         { KIND_INT,         CONF (task_width),          W_PANEL | R_PANEL },
+    [CONF_BARPOS] =             { KIND_INT,         CONF (barpos),              W_PANEL | R_PANEL },
+    [CONF_MONITOR] =            { KIND_INT,         CONF (monitor),             W_PANEL | R_PANEL },
+    [CONF_FOLDER_SIZE] =        { KIND_INT,         CONF (folder_size),         W_LIBFM },
+    [CONF_THUMB_SIZE] =         { KIND_INT,         CONF (thumb_size),          W_LIBFM },
+    [CONF_PANE_SIZE] =          { KIND_INT,         CONF (pane_size),           W_LIBFM },
+    [CONF_SICON_SIZE] =         { KIND_INT,         CONF (sicon_size),          W_LIBFM },
+    [CONF_TB_ICON_SIZE] =       { KIND_INT,         CONF (tb_icon_size),        W_SESSION | R_SESSION },
+    [CONF_LO_ICON_SIZE] =       { KIND_INT,         CONF (lo_icon_size),        W_LIBREOFFICE },
+    [CONF_CURSOR_SIZE] =        { KIND_INT,         CONF (cursor_size),         W_SESSION | R_SESSION | R_THEME },
+    [CONF_HANDLE_WIDTH] =       { KIND_INT,         CONF (handle_width),        W_SESSION | R_SESSION },
+    [CONF_SCROLLBAR_WIDTH] =    { KIND_INT,         CONF (scrollbar_width),     W_SESSION | W_GTK3 | R_SESSION | R_THEME },
+    [CONF_DARKMODE] =           { KIND_INT,         CONF (darkmode),            W_SESSION | W_GTK3 | W_QT | W_APP | W_GREETER | R_SESSION | R_THEME }
+};
+
+/* The files each writer changes, relative to the home directory - those kept
+ * are edited in place rather than written whole, so are not removed when
+ * resetting to defaults. The desktop and theme files are added by plan_files */
+static const struct
+{
+    const char *path;
+    unsigned int writers;
+    gboolean keep;
+} writer_files[] =
+{
+    { ".config/openbox/rpd-rc.xml",                             W_SESSION,      FALSE },
+    { ".config/lxsession/rpd-x/desktop.conf",                   W_SESSION,      FALSE },
+    { ".config/xsettingsd/xsettingsd.conf",                     W_SESSION,      FALSE },
+    { ".config/labwc/themerc-override",                         W_SESSION,      FALSE },
+    { ".config/labwc/rc.xml",                                   W_SESSION,      TRUE },
+    { ".config/labwc/environment",                              W_SESSION,      TRUE },
+    { ".config/wayfire.ini",                                    W_SESSION,      TRUE },
+    { ".config/lxpanel-pi/panels/panel",                        W_PANEL,        FALSE },
+    { ".config/wf-panel-pi/wf-panel-pi.ini",                    W_PANEL,        FALSE },
+    { ".config/pcmanfm/default/pcmanfm.conf",                   W_PCMAN_G,      FALSE },
+    { ".config/libfm/libfm.conf",                               W_LIBFM,        FALSE },
+    { ".config/gtk-3.0/gtk.css",                                W_GTK3,         FALSE },
+    { ".gtkrc-2.0",                                             W_GTK3,         FALSE },
+    { ".config/qt5ct/qt5ct.conf",                               W_QT,           FALSE },
+    { ".config/qt6ct/qt6ct.conf",                               W_QT,           FALSE },
+    { ".config/qt6ct/colors/pixtrix.conf",                      W_QT,           FALSE },
+    { ".config/qt6ct/colors/pixonyx.conf",                      W_QT,           FALSE },
+    { ".config/lxterminal/lxterminal.conf",                     W_LXTERM,       TRUE },
+    { ".config/libreoffice/4/user/registrymodifications.xcu",   W_LIBREOFFICE,  TRUE },
+    { ".config/geany/geany.conf",                               W_APP,          TRUE },
+    { ".config/galculator/galculator.conf",                     W_APP,          TRUE }
+};
+
+/* The Config as last written out, and as last shown while changes are staged */
+static Config committed, shown;
+
+/* Set when changes are kept in memory and previewed until flushed */
+static gboolean staged;
+
+/* Actions not to be taken on the next commit whatever has changed */
+static unsigned int skipped;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static gboolean field_changed (ConfigId field, const Config *a, const Config *b);
+static void copy_field (ConfigId field, Config *to, const Config *from);
+static void take_plan (Config *to, const Config *from, const ConfigPlan *plan);
+static unsigned int commit_fields (gboolean flush);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static gboolean field_changed (ConfigId field, const Config *a, const Config *b)
+{
+    size_t off = fields[field].offset;
+    int i;
+
+    switch (fields[field].kind)
+    {
+        case KIND_INT :     return *AT (a, off, int) != *AT (b, off, int);
+
+        case KIND_STRING :  return g_strcmp0 (*AT (a, off, const char *), *AT (b, off, const char *)) != 0;
+
+        case KIND_COLOURS : for (i = 0; i < 2; i++)
+                                if (!gdk_rgba_equal (AT (a, off, GdkRGBA) + i, AT (b, off, GdkRGBA) + i)) return TRUE;
+                            return FALSE;
+
+        default :           return FALSE;
+    }
+}
+
+static void copy_field (ConfigId field, Config *to, const Config *from)
+{
+    size_t off = fields[field].offset;
+
+    switch (fields[field].kind)
+    {
+        case KIND_INT :     *AT (to, off, int) = *AT (from, off, int);
+                            break;
+
+        case KIND_STRING :  *AT (to, off, const char *) = *AT (from, off, const char *);
+                            break;
+
+        case KIND_COLOURS : memcpy (AT (to, off, GdkRGBA), AT (from, off, GdkRGBA), 2 * sizeof (GdkRGBA));
+                            break;
+
+        default :           break;
+    }
+}
+
+/* Copies the fields in a plan - that is, those which differ */
+
+static void take_plan (Config *to, const Config *from, const ConfigPlan *plan)
+{
+    int i, d;
+
+    for (i = 0; i < N_CONF_FIELDS; i++)
+    {
+        if (!(plan->fields & (1 << i))) continue;
+
+        if (fields[i].kind == KIND_DESKTOPS)
+        {
+            for (d = 0; d < ndesks; d++)
+                if (plan->desktops[d]) to->desktops[d] = from->desktops[d];
+        }
+        else copy_field (i, to, from);
+    }
+}
+
+/* Takes the changes since the last commit, and writes out those which are due
+ * - all of them unless they are staged, in which case they are previewed and
+ * only the live fields are written until flushed */
+
+static unsigned int commit_fields (gboolean flush)
+{
+    ConfigPlan plan;
+    unsigned int mask = cur_conf.dirty, actions;
+    gboolean changed = FALSE;
+
+    cur_conf.dirty = 0;
+
+    if (staged)
+    {
+        plan_changes (&plan, &shown, &cur_conf, mask);
+        take_plan (&shown, &cur_conf, &plan);
+        if (plan.fields & ~LIVE_FIELDS) preview_theme ();
+        changed = plan.fields != 0;
+        free_plan (&plan);
+
+        if (flush) mask = CONF_ALL;
+        else mask &= LIVE_FIELDS;
+    }
+
+    plan_changes (&plan, &committed, &cur_conf, mask);
+    take_plan (&committed, &cur_conf, &plan);
+    plan.actions &= ~skipped;
+    skipped = 0;
+
+    apply_plan (&plan);
+    if (plan.fields) changed = TRUE;
+    actions = plan.actions;
+    free_plan (&plan);
+
+    if (changed) record_step ();
+    return actions;
+}
+
+gboolean same_desktop (const DesktopConfig *a, const DesktopConfig *b)
+{
+    if (g_strcmp0 (a->desktop_folder, b->desktop_folder)) return FALSE;
+    if (g_strcmp0 (a->desktop_picture, b->desktop_picture)) return FALSE;
+    if (g_strcmp0 (a->desktop_mode, b->desktop_mode)) return FALSE;
+    if (!gdk_rgba_equal (&a->desktop_colour, &b->desktop_colour)) return FALSE;
+    if (!gdk_rgba_equal (&a->desktoptext_colour, &b->desktoptext_colour)) return FALSE;
+    if (a->show_docs != b->show_docs) return FALSE;
+    if (a->show_trash != b->show_trash) return FALSE;
+    if (a->show_mnts != b->show_mnts) return FALSE;
+    if (a->match_colour != b->match_colour) return FALSE;
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Planning                                                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Works out what it takes to go from one Config to another - the fields which
+ * differ, out of those in mask, and the writers and reloads they call for */
+
+void plan_changes (ConfigPlan *plan, const Config *from, const Config *to, unsigned int mask)
+{
+    int i, d;
+
+    plan->fields = plan->actions = 0;
+    plan->desktops = g_new0 (gboolean, ndesks);
+
+    for (i = 0; i < N_CONF_FIELDS; i++)
+    {
+        if (!(mask & (1 << i))) continue;
+
+        if (fields[i].kind == KIND_DESKTOPS)
+        {
+            for (d = 0; d < ndesks; d++)
+            {
+                if (same_desktop (&from->desktops[d], &to->desktops[d])) continue;
+                plan->desktops[d] = TRUE;
+                plan->fields |= 1 << i;
+            }
+        }
+        else if (field_changed (i, from, to)) plan->fields |= 1 << i;
+
+        if (plan->fields & (1 << i)) plan->actions |= fields[i].actions;
+    }
+
+    // the desktop leaves room for the panel on Wayland
+    if ((plan->actions & R_PANEL) && wm != WM_OPENBOX) plan->actions |= R_DESKTOP;
+}
+
+/* Lists the files which the writers in a plan change, or every file if there
+ * is no plan; with removable, only those which are written whole */
+
+char **plan_files (const ConfigPlan *plan, gboolean removable)
+{
+    GPtrArray *paths = g_ptr_array_new ();
+    unsigned int writers = plan ? plan->actions : ~0U;
+    int i, d;
+
+    for (i = 0; i < G_N_ELEMENTS (writer_files); i++)
+    {
+        if (!(writers & writer_files[i].writers)) continue;
+        if (removable && writer_files[i].keep) continue;
+        g_ptr_array_add (paths, g_strdup (writer_files[i].path));
+    }
+
+    for (d = 0; d < ndesks; d++)
+    {
+        if (!(writers & W_PCMAN_ALL) && !((writers & W_PCMAN) && (!plan || plan->desktops[d]))) continue;
+        g_ptr_array_add (paths, g_strdup_printf (".config/pcmanfm/default/desktop-items-%d.conf", d));
+        if (wm != WM_OPENBOX && monitors[d].name)
+            g_ptr_array_add (paths, g_strdup_printf (".config/pcmanfm/default/desktop-items-%s.conf", monitors[d].name));
+    }
+
+    if (writers & W_GTK3)
+    {
+        g_ptr_array_add (paths, g_build_filename (".local/share/themes", theme_name (LIGHT), "gtk-3.0/gtk.css", NULL));
+        g_ptr_array_add (paths, g_build_filename (".local/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL));
+    }
+
+    g_ptr_array_add (paths, NULL);
+    return (char **) g_ptr_array_free (paths, FALSE);
+}
+
+/* Runs the writers and reloads in a plan - the writers take their values from
+ * cur_conf, so it must hold the Config being planned for. Nothing is reloaded
+ * until all the files are written */
+
+void apply_plan (const ConfigPlan *plan)
+{
+    unsigned int actions = plan->actions, written, unchanged, synced, was_written, was_unchanged, was_synced;
+    gint64 start = g_get_monotonic_time ();
+    char **files;
+    int d;
+
+    write_counts (&was_written, &was_unchanged, &was_synced);
+
+    // the files are written as a set - if interrupted, they are put back on the next run
+    files = plan_files (plan, FALSE);
+    begin_journal (files);
+    g_strfreev (files);
+
+    if (actions & W_PCMAN_G) save_pcman_g_settings ();
+    for (d = 0; d < ndesks; d++)
+        if ((actions & W_PCMAN_ALL) || ((actions & W_PCMAN) && plan->desktops[d])) save_pcman_settings (d);
+    if (actions & W_LIBFM) save_libfm_settings ();
+    if (actions & W_QT) save_qt_settings ();
+    if (actions & W_SESSION) save_session_settings ();
+    if (actions & W_GTK3) save_gtk3_settings ();
+    if (actions & W_PANEL) save_panel_settings ();
+    if (actions & W_GREETER) save_greeter_settings ();
+    if (actions & W_LXTERM) save_lxterm_settings ();
+    if (actions & W_LIBREOFFICE) save_libreoffice_settings ();
+    if (actions & W_APP) save_app_settings ();
+    end_journal ();
+
+    // the desktop files refer to a wallpaper's render only once it exists, so
+    // the renders are made in the background and the files repointed after -
+    // they are named from their contents, so one left by an earlier commit is
+    // simply used again
+    if (actions & (W_PCMAN | W_PCMAN_ALL)) render_wallpapers ();
+
+    write_counts (&written, &unchanged, &synced);
+    if (written + unchanged > was_written + was_unchanged)
+        g_debug ("commit: %u files written, %u unchanged, %u synced singly, %" G_GINT64_FORMAT " ms",
+            written - was_written, unchanged - was_unchanged, synced - was_synced, (g_get_monotonic_time () - start) / 1000);
+
+    if (actions & R_SESSION) reload_session ();
+    if (actions & R_PANEL) reload_panel ();
+    if (actions & R_DESKTOP) reload_desktop ();
+    if (actions & R_THEME) refresh_theme ();
+}
+
+void free_plan (ConfigPlan *plan)
+{
+    g_free (plan->desktops);
+    plan->desktops = NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Change tracking                                                            */
+/*----------------------------------------------------------------------------*/
+
+/* Takes the loaded Config as matching the files, so only later changes are
+ * written - and as the start of the undo history */
+
+void init_commit (void)
+{
+    if (!committed.desktops) alloc_config (&committed);
+    copy_config (&committed, &cur_conf);
+    if (!shown.desktops) alloc_config (&shown);
+    copy_config (&shown, &cur_conf);
+
+    cur_conf.dirty = 0;
+    skipped = 0;
+
+    init_history ();
+}
+
+/* While staged, changes other than to the desktop are only previewed in this
+ * process until flush_changes writes them out together */
+
+void stage_changes (gboolean stage)
+{
+    staged = stage;
+}
+
+/* The Config matching the files */
+
+const Config *written_config (void)
+{
+    return &committed;
+}
+
+void mark_dirty (ConfigId field)
+{
+    cur_conf.dirty |= 1 << field;
+}
+
+void mark_all_dirty (void)
+{
+    cur_conf.dirty = CONF_ALL;
+}
+
+/* For files which have been removed, and whose absence gives their values */
+
+void skip_actions (unsigned int actions)
+{
+    skipped |= actions;
+}
+
+/* Writes the files which use the fields that have changed since the last
+ * commit, then reloads whatever reads them. Fields which are marked dirty but
+ * hold the value already written are dropped */
+
+void commit_changes (void)
+{
+    commit_fields (FALSE);
+}
+
+/* Writes everything which differs from the files, staged or not, with a single
+ * round of reloads - returns the actions taken */
+
+unsigned int flush_changes (void)
+{
+    return commit_fields (TRUE);
+}
+
+/* Follows the monitors changing - desktops with no settings before take the
+ * ones just loaded into cur_conf, which match the files */
+
+void remap_commit (const int *map, int old_n)
+{
+    Config *confs[2] = { &committed, &shown };
+    gboolean *placed;
+    int i, d;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (!confs[i]->desktops) continue;
+        placed = remap_config (confs[i], map, old_n);
+        for (d = 0; d < ndesks; d++)
+            if (!placed[d]) confs[i]->desktops[d] = cur_conf.desktops[d];
+        g_free (placed);
+    }
+}
+
+void free_commit (void)
+{
+    free_config (&committed);
+    free_config (&shown);
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,85 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+/*----------------------------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* Writers and reloads which a change to a field calls for */
+#define W_PCMAN         (1 << 0)    /* desktops which have changed */
+#define W_PCMAN_ALL     (1 << 1)    /* every desktop */
+#define W_PCMAN_G       (1 << 2)
+#define W_LIBFM         (1 << 3)
+#define W_QT            (1 << 4)
+#define W_SESSION       (1 << 5)
+#define W_GTK3          (1 << 6)
+#define W_PANEL         (1 << 7)
+#define W_GREETER       (1 << 8)
+#define W_LXTERM        (1 << 9)
+#define W_LIBREOFFICE   (1 << 10)
+#define W_APP           (1 << 11)
+#define R_SESSION       (1 << 12)
+#define R_PANEL         (1 << 13)
+#define R_DESKTOP       (1 << 14)
+#define R_THEME         (1 << 15)
+
+/* Every tracked field */
+#define CONF_ALL        ((1 << N_CONF_FIELDS) - 1)
+
+/* What it takes to go from one Config to another */
+typedef struct {
+    unsigned int fields;        /* bits of ConfigId which differ */
+    unsigned int actions;       /* writers and reloads which they call for */
+    gboolean *desktops;         /* ndesks - whether each desktop differs */
+} ConfigPlan;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+extern gboolean same_desktop (const DesktopConfig *a, const DesktopConfig *b);
+extern void plan_changes (ConfigPlan *plan, const Config *from, const Config *to, unsigned int mask);
+extern char **plan_files (const ConfigPlan *plan, gboolean removable);
+extern void apply_plan (const ConfigPlan *plan);
+extern void free_plan (ConfigPlan *plan);
+extern void init_commit (void);
+extern void stage_changes (gboolean stage);
+extern const Config *written_config (void);
+extern void mark_dirty (ConfigId field);
+extern void mark_all_dirty (void);
+extern void skip_actions (unsigned int actions);
+extern void commit_changes (void);
+extern unsigned int flush_changes (void);
+extern void remap_commit (const int *map, int old_n);
+extern void free_commit (void);
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
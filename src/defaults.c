@@ -28,13 +28,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
 
 #include "pipanel.h"
 #include "desktop.h"
 #include "taskbar.h"
 #include "system.h"
+#include "files.h"
+#include "schema.h"
+#include "commit.h"
+#include "registry.h"
 
 #include "defaults.h"
 
@@ -42,7 +44,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /* Typedefs and macros                                                        */
 /*----------------------------------------------------------------------------*/
 
-#define GREY    "#808080"
+#define DEFAULTS_CACHE_VERSION 1
 
 /*----------------------------------------------------------------------------*/
 /* Global data                                                                */
@@ -62,10 +64,11 @@ static void defaults_lxsession (void);
 static void defaults_pcman (int desktop);
 static void defaults_pcman_g (void);
 static void defaults_gtk3 (void);
-static void save_libfm_settings (void);
-static void save_lxterm_settings (void);
-static void save_libreoffice_settings (void);
-static void reset_to_defaults (void);
+static char **defaults_sources (void);
+static void read_colour (GKeyFile *kf, const char *group, const char *key, GdkRGBA *colour);
+static gboolean load_defaults_cache (char **sources);
+static void save_defaults_cache (char **sources);
+static void reset_to_defaults (const ConfigPlan *plan);
 static void on_set_defaults (GtkButton *btn, gpointer ptr);
 
 /*----------------------------------------------------------------------------*/
@@ -129,141 +132,31 @@ static void defaults_lxpanel (void)
 
 static void defaults_lxsession (void)
 {
-    char *user_config_file, *ret;
-    GKeyFile *kf;
-    GError *err;
-    int val;
+    char *user_config_file;
 
     // read in data from system default file to a key file structure
     user_config_file = lxsession_file (TRUE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        ret = g_key_file_get_string (kf, "GTK", "sGtk/FontName", &err);
-        if (err == NULL) def_med.desktop_font = g_strdup (ret);
-        else def_med.desktop_font = "";
-        g_free (ret);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "GTK", "iGtk/CursorThemeSize", &err);
-        if (err == NULL && val >= 24 && val <= 48) def_med.cursor_size = val;
-        else def_med.cursor_size = 0;
-    }
-    else
-    {
-        def_med.desktop_font = "";
-        def_med.cursor_size = 0;
-    }
-    g_key_file_free (kf);
+    load_fields (&lxsession_schema, load_key_file (user_config_file, FALSE), &def_med, NULL);
     g_free (user_config_file);
 }
 
 static void defaults_pcman (int desktop)
 {
-    char *user_config_file, *ret;
-    GKeyFile *kf;
-    GError *err;
-    gint val;
+    char *user_config_file;
 
     // read in data from system default file to a key file structure
     user_config_file = pcmanfm_file (TRUE, desktop, FALSE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "desktop_bg", &err);
-        if (err == NULL)
-        {
-            if (!gdk_rgba_parse (&def_med.desktops[desktop].desktop_colour, ret))
-                gdk_rgba_parse (&def_med.desktops[desktop].desktop_colour, GREY);
-        }
-        else gdk_rgba_parse (&def_med.desktops[desktop].desktop_colour, GREY);
-        g_free (ret);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "desktop_fg", &err);
-        if (err == NULL)
-        {
-            if (!gdk_rgba_parse (&def_med.desktops[desktop].desktoptext_colour, ret))
-                gdk_rgba_parse (&def_med.desktops[desktop].desktoptext_colour, GREY);
-        }
-        else gdk_rgba_parse (&def_med.desktops[desktop].desktoptext_colour, GREY);
-        g_free (ret);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "wallpaper", &err);
-        if (err == NULL && ret) def_med.desktops[desktop].desktop_picture = g_strdup (ret);
-        else def_med.desktops[desktop].desktop_picture = "";
-        g_free (ret);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "wallpaper_mode", &err);
-        if (err == NULL && ret) def_med.desktops[desktop].desktop_mode = g_strdup (ret);
-        else def_med.desktops[desktop].desktop_mode = "color";
-        g_free (ret);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_documents", &err);
-        if (err == NULL && val >= 0 && val <= 1) def_med.desktops[desktop].show_docs = val;
-        else def_med.desktops[desktop].show_docs = 0;
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_trash", &err);
-        if (err == NULL && val >= 0 && val <= 1) def_med.desktops[desktop].show_trash = val;
-        else def_med.desktops[desktop].show_trash = 0;
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_mounts", &err);
-        if (err == NULL && val >= 0 && val <= 1) def_med.desktops[desktop].show_mnts = val;
-        else def_med.desktops[desktop].show_mnts = 0;
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "folder", &err);
-        if (err == NULL && ret) def_med.desktops[desktop].desktop_folder = g_strdup (ret);
-        else def_med.desktops[desktop].desktop_folder = g_build_filename (g_get_home_dir (), "Desktop", NULL);
-        g_free (ret);
-    }
-    else
-    {
-        def_med.desktops[desktop].desktop_picture = "";
-        def_med.desktops[desktop].desktop_mode = "color";
-        gdk_rgba_parse (&def_med.desktops[desktop].desktop_colour, GREY);
-        gdk_rgba_parse (&def_med.desktops[desktop].desktoptext_colour, GREY);
-        def_med.desktops[desktop].show_docs = 0;
-        def_med.desktops[desktop].show_trash = 0;
-        def_med.desktops[desktop].show_mnts = 0;
-        def_med.desktops[desktop].desktop_folder = g_build_filename (g_get_home_dir (), "Desktop", NULL);
-    }
-    g_key_file_free (kf);
+    load_fields (&pcman_schema, load_key_file (user_config_file, FALSE), &def_med.desktops[desktop], NULL);
     g_free (user_config_file);
 }
 
 static void defaults_pcman_g (void)
 {
     char *user_config_file;
-    GKeyFile *kf;
-    GError *err;
-    gint val;
 
     // read in data from system default file to a key file structure
     user_config_file = pcmanfm_g_file (TRUE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        val = g_key_file_get_integer (kf, "ui", "common_bg", &err);
-        if (err == NULL && val >= 0 && val <= 1) def_med.common_bg = val;
-        else def_med.common_bg = 0;
-    }
-    else
-    {
-        def_med.common_bg = 0;
-    }
-    g_key_file_free (kf);
+    load_fields (&pcman_g_schema, load_key_file (user_config_file, FALSE), &def_med, NULL);
     g_free (user_config_file);
 }
 
@@ -306,11 +199,10 @@ static void defaults_gtk3 (void)
     }
 }
 
-static void save_libfm_settings (void)
+void save_libfm_settings (void)
 {
-    char *user_config_file, *str;
+    char *user_config_file;
     GKeyFile *kf;
-    gsize len;
 
     // process libfm config data
     user_config_file = libfm_file ();
@@ -320,140 +212,210 @@ static void save_libfm_settings (void)
         vsystem ("cp /etc/xdg/libfm/libfm.conf %s", user_config_file);
     }
 
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+    kf = load_key_file (user_config_file, TRUE);
 
     g_key_file_set_integer (kf, "ui", "big_icon_size", cur_conf.folder_size);
     g_key_file_set_integer (kf, "ui", "thumbnail_size", cur_conf.thumb_size);
     g_key_file_set_integer (kf, "ui", "pane_icon_size", cur_conf.pane_size);
     g_key_file_set_integer (kf, "ui", "small_icon_size", cur_conf.sicon_size);
 
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
-
-    g_free (str);
-    g_key_file_free (kf);
+    save_key_file (user_config_file);
     g_free (user_config_file);
 }
 
-static void save_lxterm_settings (void)
+void save_lxterm_settings (void)
 {
-    char *user_config_file, *str;
+    char *user_config_file;
     GKeyFile *kf;
-    gsize len;
 
     // construct the file path
     user_config_file = g_build_filename (g_get_user_config_dir (), "lxterminal/lxterminal.conf", NULL);
     check_directory (user_config_file);
 
     // read in data from file to a key file
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+    kf = load_key_file (user_config_file, TRUE);
 
     // update changed values in the key file
     g_key_file_set_string (kf, "general", "fontname", cur_conf.terminal_font);
 
     // write the modified key file out
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
-
-    g_free (str);
-    g_key_file_free (kf);
+    save_key_file (user_config_file);
     g_free (user_config_file);
 }
 
-static void save_libreoffice_settings (void)
+void save_libreoffice_settings (void)
 {
-    char *user_config_file;
+    char *user_config_file, *tmp_file;
     char buf[2];
-    gboolean found = FALSE;
-    xmlChar *path, *name;
-
-    xmlDocPtr xDoc;
-    xmlXPathContextPtr xpathCtx;
-    xmlXPathObjectPtr xpathObj;
-    xmlNodePtr rootnode, itemnode, propnode, valnode;
 
     sprintf (buf, "%d", cur_conf.lo_icon_size);
 
     // construct the file path
     user_config_file = g_build_filename (g_get_user_config_dir (), "libreoffice/4/user/registrymodifications.xcu", NULL);
     check_directory (user_config_file);
+    tmp_file = g_strdup_printf ("%s.pp_new", user_config_file);
+
+    if (!write_libreoffice_settings (user_config_file, tmp_file, buf) || g_rename (tmp_file, user_config_file))
+        g_remove (tmp_file);
+
+    g_free (tmp_file);
+    g_free (user_config_file);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Defaults cache                                                             */
+/*----------------------------------------------------------------------------*/
+
+/* The system defaults only change when packages are upgraded, so the values
+ * read from them are cached, along with the stamps of every file they came
+ * from. If no stamp has changed, the cache is used instead of the files. */
+
+static char **defaults_sources (void)
+{
+    GPtrArray *sources = g_ptr_array_new ();
+    char *path;
+    int i, dark;
+
+    add_file_stamp (sources, lxpanel_file (TRUE));
+    add_file_stamp (sources, lxsession_file (TRUE));
+    for (i = 0; i < ndesks; i++)
+        add_file_stamp (sources, pcmanfm_file (TRUE, i, FALSE));
+    add_file_stamp (sources, pcmanfm_g_file (TRUE));
+
+    // every non-dark CSS file in each theme
+    for (dark = 0; dark < 2; dark++)
+    {
+        path = g_build_filename ("/usr/share/themes", theme_name (dark), "gtk-3.0", NULL);
+        add_dir_stamps (sources, path, ".css", "-dark.css");
+        g_free (path);
+    }
+
+    g_ptr_array_add (sources, NULL);
+    return (char **) g_ptr_array_free (sources, FALSE);
+}
+
+char *defaults_cache_file (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "pipanel", "defaults.conf", NULL);
+}
+
+static void read_colour (GKeyFile *kf, const char *group, const char *key, GdkRGBA *colour)
+{
+    if (!get_key_colour (kf, group, key, colour)) gdk_rgba_parse (colour, GREY);
+}
 
-    // read in data from XML file
-    xmlInitParser ();
-    LIBXML_TEST_VERSION
-    if (g_file_test (user_config_file, G_FILE_TEST_IS_REGULAR))
+static gboolean load_defaults_cache (char **sources)
+{
+    GKeyFile *kf;
+    char *cache_file, *group, *str, **cached;
+    gboolean valid = FALSE;
+    int i, dark;
+
+    cache_file = defaults_cache_file ();
+    kf = g_key_file_new ();
+    if (g_key_file_load_from_file (kf, cache_file, G_KEY_FILE_NONE, NULL)
+        && g_key_file_get_integer (kf, "cache", "version", NULL) == DEFAULTS_CACHE_VERSION)
     {
-        xDoc = xmlParseFile (user_config_file);
-        if (!xDoc) xDoc = xmlNewDoc ((xmlChar *) "1.0");
+        cached = g_key_file_get_string_list (kf, "cache", "sources", NULL, NULL);
+        valid = cached && g_strv_equal ((const char * const *) cached, (const char * const *) sources);
+        g_strfreev (cached);
     }
-    else xDoc = xmlNewDoc ((xmlChar *) "1.0");
-    xpathCtx = xmlXPathNewContext (xDoc);
+    g_free (cache_file);
 
-    // check that the oor:items node exists in the document - create it if not
-    xpathObj = xmlXPathEvalExpression ((xmlChar *) "/*[name()='oor:items']", xpathCtx);
-    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
+    if (!valid)
     {
-        rootnode = xmlNewNode (NULL, (xmlChar *) XC ("oor:items"));
-        xmlSetProp (rootnode, XC ("xmlns:oor"), XC ("http://openoffice.org/2001/registry"));
-        xmlSetProp (rootnode, XC ("xmlns:xs"), XC ("http://www.w3.org/2001/XMLSchema"));
-        xmlSetProp (rootnode, XC ("xmlns:xsi"), XC ("http://www.w3.org/2001/XMLSchema-instance"));
-        xmlDocSetRootElement (xDoc, rootnode);
+        g_key_file_free (kf);
+        return FALSE;
     }
-    else rootnode = xpathObj->nodesetval->nodeTab[0];
 
-    for (itemnode = rootnode->children; itemnode; itemnode = itemnode->next)
+    def_med.barpos = g_key_file_get_integer (kf, "defaults", "barpos", NULL);
+    def_med.icon_size = g_key_file_get_integer (kf, "defaults", "icon_size", NULL);
+    def_med.monitor = g_key_file_get_integer (kf, "defaults", "monitor", NULL);
+    def_med.desktop_font = take_conf_string (g_key_file_get_string (kf, "defaults", "desktop_font", NULL));
+    if (!def_med.desktop_font) def_med.desktop_font = "";
+    def_med.cursor_size = g_key_file_get_integer (kf, "defaults", "cursor_size", NULL);
+    def_med.common_bg = g_key_file_get_integer (kf, "defaults", "common_bg", NULL);
+    def_med.darkmode = 0;
+
+    for (dark = 0; dark < 2; dark++)
     {
-        if (itemnode->type == XML_ELEMENT_NODE && !xmlStrcmp (itemnode->name, XC ("item")))
-        {
-            path = xmlGetProp (itemnode, XC ("path"));
-            if (!xmlStrcmp (path, XC ("/org.openoffice.Office.Common/Misc")))
-            {
-                xmlNode *propnode = itemnode->children;
-                if (propnode->type == XML_ELEMENT_NODE && !xmlStrcmp (propnode->name, XC ("prop")))
-                {
-                    name = xmlGetProp (propnode, XC ("name"));
-                    if (!xmlStrcmp (name, XC ("SymbolSet")))
-                    {
-                        xmlNode *valnode = propnode->children;
-                        if (valnode->type == XML_ELEMENT_NODE && !xmlStrcmp (valnode->name, XC ("value")))
-                            xmlNodeSetContent (valnode, XC (buf));
-                        found = TRUE;
-                        xmlFree (path);
-                        xmlFree (name);
-                        break;
-                    }
-                    xmlFree (name);
-                }
-            }
-            xmlFree (path);
-        }
+        group = g_strdup_printf ("theme%d", dark);
+        read_colour (kf, group, "theme_colour", &def_med.theme_colour[dark]);
+        read_colour (kf, group, "themetext_colour", &def_med.themetext_colour[dark]);
+        read_colour (kf, group, "bar_colour", &def_med.bar_colour[dark]);
+        read_colour (kf, group, "bartext_colour", &def_med.bartext_colour[dark]);
+        g_free (group);
     }
 
-    // if node not found, add it with desired value
-    if (!found)
+    for (i = 0; i < ndesks; i++)
     {
-        itemnode = xmlNewNode (NULL, XC ("item"));
-        xmlSetProp (itemnode, XC ("oor:path"), XC ("/org.openoffice.Office.Common/Misc"));
-        propnode = xmlNewNode (NULL, XC ("prop"));
-        xmlSetProp (propnode, XC ("oor:name"), XC ("SymbolSet"));
-        xmlSetProp (propnode, XC ("oor:op"), XC ("fuse"));
-        xmlAddChild (itemnode, propnode);
-        valnode = xmlNewNode (NULL, XC ("value"));
-        xmlNodeSetContent (valnode, XC (buf));
-        xmlAddChild (propnode, valnode);
-        xmlAddChild (rootnode, itemnode);
+        group = g_strdup_printf ("desktop%d", i);
+        read_colour (kf, group, "desktop_colour", &def_med.desktops[i].desktop_colour);
+        read_colour (kf, group, "desktoptext_colour", &def_med.desktops[i].desktoptext_colour);
+        def_med.desktops[i].desktop_picture = take_conf_string (g_key_file_get_string (kf, group, "desktop_picture", NULL));
+        if (!def_med.desktops[i].desktop_picture) def_med.desktops[i].desktop_picture = "";
+        def_med.desktops[i].desktop_mode = take_conf_string (g_key_file_get_string (kf, group, "desktop_mode", NULL));
+        if (!def_med.desktops[i].desktop_mode) def_med.desktops[i].desktop_mode = "color";
+        def_med.desktops[i].show_docs = g_key_file_get_integer (kf, group, "show_docs", NULL);
+        def_med.desktops[i].show_trash = g_key_file_get_integer (kf, group, "show_trash", NULL);
+        def_med.desktops[i].show_mnts = g_key_file_get_integer (kf, group, "show_mnts", NULL);
+        def_med.desktops[i].match_colour = 0;
+        str = g_key_file_get_string (kf, group, "desktop_folder", NULL);
+        if (!str) str = g_build_filename (g_get_home_dir (), "Desktop", NULL);
+        def_med.desktops[i].desktop_folder = take_conf_string (str);
+        g_free (group);
     }
 
-    // cleanup XML
-    xmlXPathFreeObject (xpathObj);
-    xmlXPathFreeContext (xpathCtx);
-    xmlSaveFile (user_config_file, xDoc);
-    xmlFreeDoc (xDoc);
-    xmlCleanupParser ();
+    g_key_file_free (kf);
+    return TRUE;
+}
+
+static void save_defaults_cache (char **sources)
+{
+    GKeyFile *kf;
+    char *cache_file, *group;
+    int i, dark;
 
-    g_free (user_config_file);
+    kf = g_key_file_new ();
+    g_key_file_set_integer (kf, "cache", "version", DEFAULTS_CACHE_VERSION);
+    g_key_file_set_string_list (kf, "cache", "sources", (const char * const *) sources, g_strv_length (sources));
+
+    g_key_file_set_integer (kf, "defaults", "barpos", def_med.barpos);
+    g_key_file_set_integer (kf, "defaults", "icon_size", def_med.icon_size);
+    g_key_file_set_integer (kf, "defaults", "monitor", def_med.monitor);
+    g_key_file_set_string (kf, "defaults", "desktop_font", def_med.desktop_font);
+    g_key_file_set_integer (kf, "defaults", "cursor_size", def_med.cursor_size);
+    g_key_file_set_integer (kf, "defaults", "common_bg", def_med.common_bg);
+
+    for (dark = 0; dark < 2; dark++)
+    {
+        group = g_strdup_printf ("theme%d", dark);
+        set_key_colour (kf, group, "theme_colour", &def_med.theme_colour[dark]);
+        set_key_colour (kf, group, "themetext_colour", &def_med.themetext_colour[dark]);
+        set_key_colour (kf, group, "bar_colour", &def_med.bar_colour[dark]);
+        set_key_colour (kf, group, "bartext_colour", &def_med.bartext_colour[dark]);
+        g_free (group);
+    }
+
+    for (i = 0; i < ndesks; i++)
+    {
+        group = g_strdup_printf ("desktop%d", i);
+        set_key_colour (kf, group, "desktop_colour", &def_med.desktops[i].desktop_colour);
+        set_key_colour (kf, group, "desktoptext_colour", &def_med.desktops[i].desktoptext_colour);
+        g_key_file_set_string (kf, group, "desktop_picture", def_med.desktops[i].desktop_picture);
+        g_key_file_set_string (kf, group, "desktop_mode", def_med.desktops[i].desktop_mode);
+        g_key_file_set_integer (kf, group, "show_docs", def_med.desktops[i].show_docs);
+        g_key_file_set_integer (kf, group, "show_trash", def_med.desktops[i].show_trash);
+        g_key_file_set_integer (kf, group, "show_mnts", def_med.desktops[i].show_mnts);
+        g_key_file_set_string (kf, group, "desktop_folder", def_med.desktops[i].desktop_folder);
+        g_free (group);
+    }
+
+    cache_file = defaults_cache_file ();
+    check_directory (cache_file);
+    g_key_file_save_to_file (kf, cache_file, NULL);
+    g_free (cache_file);
+    g_key_file_free (kf);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -489,75 +451,55 @@ void init_session (const char *theme)
     g_free (user_config_file);
 }
 
-static void reset_to_defaults (void)
+static void reset_to_defaults (const ConfigPlan *plan)
 {
-    char *path, *monname;
+    char **files, *theme;
     int i;
 
-    delete_file (".config/openbox/rpd-rc.xml");
-    delete_file (".config/lxsession/rpd-x/desktop.conf");
-    delete_file (".config/lxpanel-pi/panels/panel");
-    delete_file (".config/wf-panel-pi/wf-panel-pi.ini");
-    delete_file (".config/pcmanfm/default/pcmanfm.conf");
-
-    for (i = 0; i < ndesks; i++)
-    {
-        path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%d.conf", i);
-        delete_file (path);
-        g_free (path);
-
-        if (wm != WM_OPENBOX)
-        {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-            monname = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), i);
-#pragma GCC diagnostic pop
-            path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%s.conf", monname);
-            delete_file (path);
-            g_free (path);
-            g_free (monname);
-        }
-    }
-
-    path = g_build_filename (".local/share/themes", theme_name (LIGHT), "gtk-3.0/gtk.css", NULL);
-    delete_file (path);
-    g_free (path);
+    // note the theme in use before its session file is removed
+    theme = get_theme ();
 
-    path = g_build_filename (".local/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
-    delete_file (path);
-    g_free (path);
+    files = plan_files (plan, TRUE);
+    for (i = 0; files[i]; i++) delete_file (files[i]);
+    g_strfreev (files);
 
-    delete_file (".config/libfm/libfm.conf");
-    delete_file (".config/gtk-3.0/gtk.css");
-    delete_file (".config/qt5ct/qt5ct.conf");
-    delete_file (".config/qt6ct/qt6ct.conf");
-    delete_file (".config/xsettingsd/xsettingsd.conf");
-    delete_file (".config/labwc/themerc-override");
-    delete_file (".gtkrc-2.0");
-
-    init_session (theme_name (TEMP));
+    if (plan->actions & (W_PCMAN | W_PCMAN_ALL)) update_monitors ();
+    if (plan->actions & W_SESSION) init_session (theme ? theme : theme_name (TEMP));
+    g_free (theme);
 }
 
 void create_defaults (void)
 {
+    char **sources;
     int i;
-    // defaults for controls
 
-    // /etc/xdg/lxpanel-pi/panels/panel
-    defaults_lxpanel ();
+    alloc_config (&def_med);
+    alloc_config (&def_lg);
+    alloc_config (&def_sm);
 
-    // /etc/xdg/lxsession/LXDE-pi/desktop.conf
-    defaults_lxsession ();
+    // defaults for controls - read from the cache if none of the source files have changed
+    sources = defaults_sources ();
+    if (!load_defaults_cache (sources))
+    {
+        // /etc/xdg/lxpanel-pi/panels/panel
+        defaults_lxpanel ();
 
-    // /etc/xdg/pcmanfm/LXDE-pi/desktop-items-n.conf
-    for (i = 0; i < ndesks; i++)
-        defaults_pcman (i);
+        // /etc/xdg/lxsession/LXDE-pi/desktop.conf
+        defaults_lxsession ();
 
-    // /etc/xdg/pcmanfm/LXDE-pi/pcmanfm.conf
-    defaults_pcman_g ();
+        // /etc/xdg/pcmanfm/LXDE-pi/desktop-items-n.conf
+        for (i = 0; i < ndesks; i++)
+            defaults_pcman (i);
+
+        // /etc/xdg/pcmanfm/LXDE-pi/pcmanfm.conf
+        defaults_pcman_g ();
 
-    // GTK 3 theme defaults
-    defaults_gtk3 ();
+        // GTK 3 theme defaults
+        defaults_gtk3 ();
+
+        save_defaults_cache (sources);
+    }
+    g_strfreev (sources);
 
     // defaults with no dedicated controls - set on defaults buttons only,
     // so the values set in these are only used in the large and small cases
@@ -573,7 +515,8 @@ void create_defaults (void)
     def_med.handle_width = 10;
     def_med.scrollbar_width = 13;
 
-    def_lg = def_sm = def_med;
+    copy_config (&def_lg, &def_med);
+    copy_config (&def_sm, &def_med);
 
     def_lg.icon_size = 52;
     def_lg.cursor_size = 36;
@@ -615,13 +558,38 @@ void create_defaults (void)
     }
 }
 
+/* Re-reads the desktop defaults when the number of monitors has changed */
+
+void update_desktop_defaults (void)
+{
+    int i;
+
+    alloc_config (&def_med);
+    alloc_config (&def_lg);
+    alloc_config (&def_sm);
+
+    for (i = 0; i < ndesks; i++)
+        defaults_pcman (i);
+
+    memcpy (def_lg.desktops, def_med.desktops, ndesks * sizeof (DesktopConfig));
+    memcpy (def_sm.desktops, def_med.desktops, ndesks * sizeof (DesktopConfig));
+}
+
+void free_defaults (void)
+{
+    free_config (&def_med);
+    free_config (&def_lg);
+    free_config (&def_sm);
+}
+
 /*----------------------------------------------------------------------------*/
 /* Control handlers                                                           */
 /*----------------------------------------------------------------------------*/
 
 static void on_set_defaults (GtkButton *btn, gpointer ptr)
 {
-    int i;
+    ConfigPlan plan;
+    const Config *preset;
 
     if (cur_conf.darkmode == 1)
     {
@@ -638,49 +606,35 @@ static void on_set_defaults (GtkButton *btn, gpointer ptr)
         }
     }
 
-    // clear all the config files
-    reset_to_defaults ();
-
-    // set config structure to a default
     switch ((long int) ptr)
     {
-        case 3 :    cur_conf = def_lg;
+        case 3 :    preset = &def_lg;
                     break;
-        case 1 :    cur_conf = def_sm;
+        case 1 :    preset = &def_sm;
                     break;
-        default :   cur_conf = def_med;
+        default :   preset = &def_med;
     }
 
+    // only the files used by settings which differ from the preset are cleared
+    plan_changes (&plan, written_config (), preset, CONF_ALL);
+    reset_to_defaults (&plan);
+    free_plan (&plan);
+
+    // set config structure to the preset
+    copy_config (&cur_conf, preset);
+    mark_all_dirty ();
+
     // reset the GUI controls to match the variables
     set_desktop_controls ();
     set_taskbar_controls ();
     set_system_controls ();
 
-    // save changes to files if not using medium (the global default)
-    if ((long int) ptr != 2)
-    {
-        save_pcman_g_settings ();
-        for (i = 0; i < ndesks; i++)
-            save_pcman_settings (i);
-        save_libfm_settings ();
-        save_qt_settings ();
-    }
+    // the files cleared above are written again, except for those which medium
+    // (the global default) leaves absent
+    if ((long int) ptr == 2) skip_actions (W_PCMAN_G | W_PCMAN | W_PCMAN_ALL | W_LIBFM | W_QT);
 
-    save_session_settings ();
-    save_gtk3_settings ();
-    save_panel_settings ();
-    save_greeter_settings ();
-
-    // save application-specific config - we don't delete these files first...
-    save_lxterm_settings ();
-    save_libreoffice_settings ();
-    save_app_settings ();
-
-    // reload everything to reflect the current state
-    reload_session ();
-    reload_panel ();
-    reload_desktop ();
-    reload_theme (FALSE);
+    // the files are gone, so this is written out even if changes are staged
+    flush_changes ();
 }
 
 /*----------------------------------------------------------------------------*/
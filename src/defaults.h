@@ -42,6 +42,12 @@ extern Config def_med;
 
 extern void init_session (const char *theme);
 extern void create_defaults (void);
+extern void update_desktop_defaults (void);
+extern void free_defaults (void);
+extern char *defaults_cache_file (void);
+extern void save_libfm_settings (void);
+extern void save_lxterm_settings (void);
+extern void save_libreoffice_settings (void);
 extern void load_defaults_tab (GtkBuilder *builder);
 
 /* End of file */
@@ -29,6 +29,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pipanel.h"
 #include "defaults.h"
+#include "files.h"
+#include "snapshot.h"
+#include "gallery.h"
+#include "wallpaper.h"
+#include "schema.h"
+#include "commit.h"
+#include "history.h"
 
 #include "desktop.h"
 
@@ -41,11 +48,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 /*----------------------------------------------------------------------------*/
 
 /* Controls */
-static GtkWidget *colour_desktop, *colour_desktoptext, *combo_mode, *file_picture;
+static GtkWidget *colour_desktop, *colour_desktoptext, *combo_mode, *file_picture, *box_picture;
 static GtkWidget *file_folder, *combo_monitor, *toggle_docs, *toggle_trash, *toggle_mnts, *toggle_same;
+static GtkWidget *toggle_match, *box_monitor;
 
 /* Handler IDs */
-static gulong id_mode, id_docs, id_trash, id_mnts, id_folder, id_same, id_monitor;
+static gulong id_mode, id_docs, id_trash, id_mnts, id_folder, id_same, id_monitor, id_match;
 
 /* Currently-selected desktop */
 static int desktop_n;
@@ -61,7 +69,10 @@ static void on_desktop_changed (GtkComboBox *cb, gpointer ptr);
 static void on_desktop_same (GtkCheckButton *btn, gpointer ptr);
 static void on_desktop_mode_set (GtkComboBox *btn, gpointer ptr);
 static void on_desktop_picture_set (GtkFileChooser *btn, gpointer ptr);
+static void on_desktop_gallery (GtkButton *btn, gpointer ptr);
 static void on_desktop_colour_set (GtkColorChooser *btn, gpointer ptr);
+static void on_desktop_match (GtkCheckButton *btn, gpointer ptr);
+static void match_wallpaper (void);
 static void on_desktop_textcolour_set (GtkColorChooser *btn, gpointer ptr);
 static void on_desktop_folder_set (GtkFileChooser *btn, gpointer ptr);
 static void on_toggle_docs (GtkSwitch *btn, gpointer, gpointer);
@@ -106,7 +117,7 @@ static void atk_label (GtkWidget *widget, GtkLabel *label)
 char *pcmanfm_file (gboolean global, int desktop, gboolean write)
 {
     char *fname, *buf;
-    if (desktop < 0 || desktop > MAX_DESKTOPS) return NULL;
+    if (desktop < 0 || desktop >= ndesks) return NULL;
     if (cur_conf.common_bg)
     {
         fname = g_strdup_printf ("desktop-items-0.conf");
@@ -115,21 +126,16 @@ char *pcmanfm_file (gboolean global, int desktop, gboolean write)
         return buf;
     }
 
-    if (wm != WM_OPENBOX)
+    if (wm != WM_OPENBOX && monitors[desktop].name)
     {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-        buf = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), desktop);
-#pragma GCC diagnostic pop
-        fname = g_strdup_printf ("desktop-items-%s.conf", buf);
-        g_free (buf);
-        buf = g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "pcmanfm", "default", fname, NULL);
-        g_free (fname);
-        if (write || access (buf, F_OK) == 0) return buf;
-        else g_free (buf);
-        if (global && desktop > 1) desktop = 1; // only 2 numbered global desktop files
+        // the file is about to be created if it is being written
+        if (write) monitors[desktop].pcman_exists[global] = TRUE;
+        if (monitors[desktop].pcman_exists[global]) return g_strdup (monitors[desktop].pcman_file[global]);
     }
 
+    // there are only 2 numbered global desktop files
+    if (global && desktop > 1) desktop = 1;
+
     fname = g_strdup_printf ("desktop-items-%u.conf", desktop);
     buf = g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "pcmanfm", "default", fname, NULL);
     g_free (fname);
@@ -143,108 +149,32 @@ char *pcmanfm_g_file (gboolean global)
 
 static void load_pcman_settings (int desktop)
 {
+    DesktopConfig *dc = &cur_conf.desktops[desktop];
     char *user_config_file, *ret;
     GKeyFile *kf;
-    GError *err;
-    gint val;
 
     // read in data from file to a key file
     user_config_file = pcmanfm_file (FALSE, desktop, FALSE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "desktop_bg", &err);
-        if (err == NULL)
-        {
-            if (!gdk_rgba_parse (&cur_conf.desktops[desktop].desktop_colour, ret))
-                DEFAULT (desktops[desktop].desktop_colour);
-        }
-        else DEFAULT (desktops[desktop].desktop_colour);
-        g_free (ret);
+    kf = load_key_file (user_config_file, FALSE);
+    load_fields (&pcman_schema, kf, dc, &def_med.desktops[desktop]);
 
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "desktop_fg", &err);
-        if (err == NULL)
-        {
-            if (!gdk_rgba_parse (&cur_conf.desktops[desktop].desktoptext_colour, ret))
-                DEFAULT (desktops[desktop].desktoptext_colour);
-        }
-        else DEFAULT (desktops[desktop].desktoptext_colour);
-        g_free (ret);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "wallpaper", &err);
-        if (err == NULL && ret) cur_conf.desktops[desktop].desktop_picture = g_strdup (ret);
-        else DEFAULT (desktops[desktop].desktop_picture);
-        g_free (ret);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "wallpaper_mode", &err);
-        if (err == NULL && ret) cur_conf.desktops[desktop].desktop_mode = g_strdup (ret);
-        else DEFAULT (desktops[desktop].desktop_mode);
-        g_free (ret);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_documents", &err);
-        if (err == NULL && val >= 0 && val <= 1) cur_conf.desktops[desktop].show_docs = val;
-        else DEFAULT (desktops[desktop].show_docs);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_trash", &err);
-        if (err == NULL && val >= 0 && val <= 1) cur_conf.desktops[desktop].show_trash = val;
-        else DEFAULT (desktops[desktop].show_trash);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "*", "show_mounts", &err);
-        if (err == NULL && val >= 0 && val <= 1) cur_conf.desktops[desktop].show_mnts = val;
-        else DEFAULT (desktops[desktop].show_mnts);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "*", "folder", &err);
-        if (err == NULL && ret) cur_conf.desktops[desktop].desktop_folder = g_strdup (ret);
-        else DEFAULT (desktops[desktop].desktop_folder);
-        g_free (ret);
-    }
-    else
+    // a rendered copy stands in for the picture it was made from
+    if (kf && is_rendered_wallpaper (dc->desktop_picture))
     {
-        DEFAULT (desktops[desktop].desktop_colour);
-        DEFAULT (desktops[desktop].desktoptext_colour);
-        DEFAULT (desktops[desktop].desktop_picture);
-        DEFAULT (desktops[desktop].desktop_mode);
-        DEFAULT (desktops[desktop].show_docs);
-        DEFAULT (desktops[desktop].show_trash);
-        DEFAULT (desktops[desktop].show_mnts);
-        DEFAULT (desktops[desktop].desktop_folder);
+        ret = g_key_file_get_string (kf, "*", "wallpaper_source", NULL);
+        if (ret) dc->desktop_picture = take_conf_string (ret);
+        else DEFAULT (desktops[desktop].desktop_picture);
     }
-    g_key_file_free (kf);
     g_free (user_config_file);
 }
 
 static void load_pcman_g_settings (void)
 {
     char *user_config_file;
-    GKeyFile *kf;
-    GError *err;
-    gint val;
 
     // read in data from file to a key file
     user_config_file = pcmanfm_g_file (FALSE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        val = g_key_file_get_integer (kf, "ui", "common_bg", &err);
-        if (err == NULL && val >= 0 && val <= 1) cur_conf.common_bg = val;
-        else DEFAULT (common_bg);
-    }
-    else
-    {
-        DEFAULT (common_bg);
-    }
-    g_key_file_free (kf);
+    load_fields (&pcman_g_schema, load_key_file (user_config_file, FALSE), &cur_conf, &def_med);
     g_free (user_config_file);
 }
 
@@ -252,72 +182,97 @@ void save_pcman_settings (int desktop)
 {
     char *user_config_file, *str;
     GKeyFile *kf;
-    gsize len;
 
     user_config_file = pcmanfm_file (FALSE, desktop, TRUE);
     check_directory (user_config_file);
 
     // process pcmanfm config data
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
-
-    str = rgba_to_gdk_color_string (&cur_conf.desktops[desktop].desktop_colour);
-    g_key_file_set_string (kf, "*", "desktop_bg", str);
-    g_key_file_set_string (kf, "*", "desktop_shadow", str);
-    g_free (str);
-
-    str = rgba_to_gdk_color_string (&cur_conf.desktops[desktop].desktoptext_colour);
-    g_key_file_set_string (kf, "*", "desktop_fg", str);
-    g_free (str);
-
+    kf = load_key_file (user_config_file, TRUE);
+    save_fields (&pcman_schema, kf, &cur_conf.desktops[desktop]);
     g_key_file_set_string (kf, "*", "desktop_font", cur_conf.desktop_font);
-    g_key_file_set_string (kf, "*", "wallpaper", cur_conf.desktops[desktop].desktop_picture);
-    g_key_file_set_string (kf, "*", "wallpaper_mode", cur_conf.desktops[desktop].desktop_mode);
-    g_key_file_set_integer (kf, "*", "show_documents", cur_conf.desktops[desktop].show_docs);
-    g_key_file_set_integer (kf, "*", "show_trash", cur_conf.desktops[desktop].show_trash);
-    g_key_file_set_integer (kf, "*", "show_mounts", cur_conf.desktops[desktop].show_mnts);
-    g_key_file_set_string (kf, "*", "folder", cur_conf.desktops[desktop].desktop_folder);
-
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
+
+    // pcmanfm is given the copy rendered at the size of the monitor, if there is one
+    str = wallpaper_file (desktop);
+    g_key_file_set_string (kf, "*", "wallpaper", str);
     g_free (str);
 
-    g_key_file_free (kf);
+    save_key_file (user_config_file);
     g_free (user_config_file);
 }
 
 void save_pcman_g_settings (void)
 {
-    char *user_config_file, *str;
+    char *user_config_file;
     GKeyFile *kf;
-    gsize len;
 
     user_config_file = pcmanfm_g_file (FALSE);
     check_directory (user_config_file);
 
     // process pcmanfm config data
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+    kf = load_key_file (user_config_file, TRUE);
+    save_fields (&pcman_g_schema, kf, &cur_conf);
 
-    g_key_file_set_integer (kf, "ui", "common_bg", cur_conf.common_bg);
+    save_key_file (user_config_file);
+    g_free (user_config_file);
+}
 
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
-    g_free (str);
+/* Moves each desktop's settings to the position map_desktops gives it - an
+ * output which was not there before has its settings read from its own file */
 
-    g_key_file_free (kf);
-    g_free (user_config_file);
+void remap_desktops (const int *map, int old_n)
+{
+    gboolean *placed;
+    int d;
+
+    placed = remap_config (&cur_conf, map, old_n);
+    for (d = 0; d < ndesks; d++)
+        if (!placed[d]) load_pcman_settings (d);
+    g_free (placed);
+
+    // the written and shown settings, and the undo history, follow the same
+    // outputs; staged changes stay staged
+    remap_commit (map, old_n);
+    remap_history (map, old_n);
+
+    if (desktop_n >= ndesks) desktop_n = 0;
+    set_desktop_controls ();
 }
 
 /*----------------------------------------------------------------------------*/
 /* Set controls to match data                                                 */
 /*----------------------------------------------------------------------------*/
 
+/* Stops the monitor list's handler seeing its rows being rebuilt */
+
+void block_desktop_monitor (gboolean block)
+{
+    if (!combo_monitor) return;
+    if (block) g_signal_handler_block (combo_monitor, id_monitor);
+    else g_signal_handler_unblock (combo_monitor, id_monitor);
+}
+
+/* The monitor list is only shown if there is more than one monitor */
+
+void show_desktop_monitors (void)
+{
+    if (!box_monitor) return;
+    if (ndesks > 1)
+    {
+        gtk_widget_show (box_monitor);
+        gtk_widget_show (GTK_WIDGET (toggle_same));
+    }
+    else gtk_widget_hide (box_monitor);
+}
+
 void set_desktop_controls (void)
 {
     GtkTreeIter iter;
+    gboolean valid;
     int val;
 
+    // nothing to do if the tab has not been built yet
+    if (!combo_mode) return;
+
     g_signal_handler_block (combo_mode, id_mode);
     g_signal_handler_block (toggle_docs, id_docs);
     g_signal_handler_block (toggle_trash, id_trash);
@@ -325,6 +280,7 @@ void set_desktop_controls (void)
     g_signal_handler_block (file_folder, id_folder);
     g_signal_handler_block (toggle_same, id_same);
     g_signal_handler_block (combo_monitor, id_monitor);
+    g_signal_handler_block (toggle_match, id_match);
     
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle_same), cur_conf.common_bg);
     if (ndesks > 1)
@@ -337,19 +293,19 @@ void set_desktop_controls (void)
         }
         else
         {
-            gtk_tree_model_get_iter_first (GTK_TREE_MODEL (sortmons), &iter);
-            gtk_tree_model_get (GTK_TREE_MODEL (sortmons), &iter, 0, &val, -1);
-            while (val != desktop_n)
+            valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (sortmons), &iter);
+            while (valid)
             {
-                gtk_tree_model_iter_next (GTK_TREE_MODEL (sortmons), &iter);
                 gtk_tree_model_get (GTK_TREE_MODEL (sortmons), &iter, 0, &val, -1);
+                if (val == desktop_n) break;
+                valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (sortmons), &iter);
             }
-            gtk_combo_box_set_active_iter (GTK_COMBO_BOX (combo_monitor), &iter);
+            if (valid) gtk_combo_box_set_active_iter (GTK_COMBO_BOX (combo_monitor), &iter);
             gtk_widget_set_sensitive (GTK_WIDGET (combo_monitor), TRUE);
         }
     }
 
-    gtk_widget_set_sensitive (GTK_WIDGET (file_picture), TRUE);
+    gtk_widget_set_sensitive (GTK_WIDGET (box_picture), TRUE);
     gtk_file_chooser_set_filename (GTK_FILE_CHOOSER (file_picture), cur_conf.desktops[desktop_n].desktop_picture);
     if (!strcmp (cur_conf.desktops[desktop_n].desktop_mode, "center")) gtk_combo_box_set_active (GTK_COMBO_BOX (combo_mode), 1);
     else if (!strcmp (cur_conf.desktops[desktop_n].desktop_mode, "fit")) gtk_combo_box_set_active (GTK_COMBO_BOX (combo_mode), 2);
@@ -359,9 +315,10 @@ void set_desktop_controls (void)
     else
     {
         gtk_combo_box_set_active (GTK_COMBO_BOX (combo_mode), 0);
-        gtk_widget_set_sensitive (GTK_WIDGET (file_picture), FALSE);
+        gtk_widget_set_sensitive (GTK_WIDGET (box_picture), FALSE);
     }
     gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (colour_desktop), &cur_conf.desktops[desktop_n].desktop_colour);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle_match), cur_conf.desktops[desktop_n].match_colour);
     gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (colour_desktoptext), &cur_conf.desktops[desktop_n].desktoptext_colour);
     gtk_switch_set_active (GTK_SWITCH (toggle_docs), cur_conf.desktops[desktop_n].show_docs);
     gtk_switch_set_active (GTK_SWITCH (toggle_trash), cur_conf.desktops[desktop_n].show_trash);
@@ -375,6 +332,7 @@ void set_desktop_controls (void)
     g_signal_handler_unblock (toggle_trash, id_trash);
     g_signal_handler_unblock (toggle_mnts, id_mnts);
     g_signal_handler_unblock (file_folder, id_folder);
+    g_signal_handler_unblock (toggle_match, id_match);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -412,9 +370,8 @@ static void on_desktop_same (GtkCheckButton *btn, gpointer ptr)
         for (i = 0; i < ndesks; i++) load_pcman_settings (i);
     }
     set_desktop_controls ();
-    save_pcman_g_settings ();
-    save_pcman_settings (0);
-    reload_desktop ();
+    mark_dirty (CONF_COMMON_BG);
+    commit_changes ();
 }
 
 static void on_desktop_mode_set (GtkComboBox *btn, gpointer ptr)
@@ -436,36 +393,81 @@ static void on_desktop_mode_set (GtkComboBox *btn, gpointer ptr)
                     break;
     }
 
-    if (!strcmp (cur_conf.desktops[desktop_n].desktop_mode, "color")) gtk_widget_set_sensitive (GTK_WIDGET (file_picture), FALSE);
-    else gtk_widget_set_sensitive (GTK_WIDGET (file_picture), TRUE);
+    if (!strcmp (cur_conf.desktops[desktop_n].desktop_mode, "color")) gtk_widget_set_sensitive (GTK_WIDGET (box_picture), FALSE);
+    else gtk_widget_set_sensitive (GTK_WIDGET (box_picture), TRUE);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    match_wallpaper ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 static void on_desktop_picture_set (GtkFileChooser *btn, gpointer ptr)
 {
     char *picture = gtk_file_chooser_get_filename (btn);
-    if (picture) cur_conf.desktops[desktop_n].desktop_picture = picture;
+    if (picture) cur_conf.desktops[desktop_n].desktop_picture = take_conf_string (picture);
+
+    match_wallpaper ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
+}
+
+static void on_desktop_gallery (GtkButton *btn, gpointer ptr)
+{
+    char *picture = choose_wallpaper (GTK_WIDGET (btn), cur_conf.desktops[desktop_n].desktop_picture);
+    if (!picture) return;
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    cur_conf.desktops[desktop_n].desktop_picture = take_conf_string (picture);
+    gtk_file_chooser_set_filename (GTK_FILE_CHOOSER (file_picture), cur_conf.desktops[desktop_n].desktop_picture);
+
+    match_wallpaper ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 static void on_desktop_colour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.desktops[desktop_n].desktop_colour);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    // a colour chosen by hand replaces the matched one
+    if (cur_conf.desktops[desktop_n].match_colour)
+    {
+        cur_conf.desktops[desktop_n].match_colour = 0;
+        g_signal_handler_block (toggle_match, id_match);
+        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle_match), FALSE);
+        g_signal_handler_unblock (toggle_match, id_match);
+    }
+
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
+}
+
+static void on_desktop_match (GtkCheckButton *btn, gpointer ptr)
+{
+    cur_conf.desktops[desktop_n].match_colour = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (btn));
+
+    match_wallpaper ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
+}
+
+/* Sets the desktop colour from the picture, if it is to match */
+
+static void match_wallpaper (void)
+{
+    DesktopConfig *dc = &cur_conf.desktops[desktop_n];
+
+    if (!dc->match_colour || !strcmp (dc->desktop_mode, "color")) return;
+    if (!wallpaper_colour (dc->desktop_picture, dc->desktop_mode, &dc->desktop_colour)) return;
+
+    gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (colour_desktop), &dc->desktop_colour);
 }
 
 static void on_desktop_textcolour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.desktops[desktop_n].desktoptext_colour);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 static void on_desktop_folder_set (GtkFileChooser *btn, gpointer ptr)
@@ -473,13 +475,10 @@ static void on_desktop_folder_set (GtkFileChooser *btn, gpointer ptr)
     char *folder = gtk_file_chooser_get_filename (btn);
     if (folder)
     {
-        if (g_strcmp0 (cur_conf.desktops[desktop_n].desktop_folder, folder))
-        {
-            cur_conf.desktops[desktop_n].desktop_folder = folder;
+        cur_conf.desktops[desktop_n].desktop_folder = take_conf_string (folder);
 
-            save_pcman_settings (desktop_n);
-            reload_desktop ();
-        }
+        mark_dirty (CONF_DESKTOP);
+        commit_changes ();
     }
 }
 
@@ -487,46 +486,58 @@ static void on_toggle_docs (GtkSwitch *btn, gpointer, gpointer)
 {
     cur_conf.desktops[desktop_n].show_docs = gtk_switch_get_active (btn);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 static void on_toggle_trash (GtkSwitch *btn, gpointer, gpointer)
 {
     cur_conf.desktops[desktop_n].show_trash = gtk_switch_get_active (btn);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 static void on_toggle_mnts (GtkSwitch *btn, gpointer, gpointer)
 {
     cur_conf.desktops[desktop_n].show_mnts = gtk_switch_get_active (btn);
 
-    save_pcman_settings (desktop_n);
-    reload_desktop ();
+    mark_dirty (CONF_DESKTOP);
+    commit_changes ();
 }
 
 /*----------------------------------------------------------------------------*/
 /* Initialisation                                                             */
 /*----------------------------------------------------------------------------*/
 
+void load_desktop_settings (void)
+{
+    int i;
+
+    if (!restore_snapshot (SNAP_DESKTOP))
+    {
+        load_pcman_g_settings ();
+        for (i = 0; i < ndesks; i++)
+            load_pcman_settings (i);
+    }
+    if (clean_wallpapers ()) reload_desktop ();
+
+    desktop_n = 0;
+}
+
 void load_desktop_tab (GtkBuilder *builder)
 {
+    GtkCellRenderer *rend;
     GtkWidget *wid;
     GtkLabel *lbl;
     GList *children, *child;
-    int i;
-
-    load_pcman_g_settings ();
-    for (i = 0; i < ndesks; i++)
-        load_pcman_settings (i);
-    
-    desktop_n = 0;
 
     colour_desktop = (GtkWidget *) gtk_builder_get_object (builder, "colorbutton2");
     g_signal_connect (colour_desktop, "color-set", G_CALLBACK (on_desktop_colour_set), NULL);
 
+    toggle_match = (GtkWidget *) gtk_builder_get_object (builder, "checkbutton5");
+    id_match = g_signal_connect (toggle_match, "toggled", G_CALLBACK (on_desktop_match), NULL);
+
     colour_desktoptext = (GtkWidget *) gtk_builder_get_object (builder, "colorbutton6");
     g_signal_connect (colour_desktoptext, "color-set", G_CALLBACK (on_desktop_textcolour_set), NULL);
 
@@ -548,6 +559,9 @@ void load_desktop_tab (GtkBuilder *builder)
     } while ((child = g_list_next (child)) != NULL);
     g_list_free (children);
 
+    box_picture = (GtkWidget *) gtk_builder_get_object (builder, "hbox_picture");
+    g_signal_connect (gtk_builder_get_object (builder, "gallerybutton"), "clicked", G_CALLBACK (on_desktop_gallery), NULL);
+
     combo_mode = (GtkWidget *) gtk_builder_get_object (builder, "comboboxtext1");
     id_mode = g_signal_connect (combo_mode, "changed", G_CALLBACK (on_desktop_mode_set), NULL);
 
@@ -584,20 +598,14 @@ void load_desktop_tab (GtkBuilder *builder)
     } while ((child = g_list_next (child)) != NULL);
     g_list_free (children);
 
-    if (ndesks > 1)
-    {
-        GtkCellRenderer *rend = gtk_cell_renderer_text_new ();
-
-        gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo_monitor), rend, FALSE);
-        gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (combo_monitor), rend, "text", 1);
-        gtk_combo_box_set_model (GTK_COMBO_BOX (combo_monitor), GTK_TREE_MODEL (sortmons));
+    // the list is set up even for one monitor, so it is ready if another is plugged in
+    rend = gtk_cell_renderer_text_new ();
+    gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo_monitor), rend, FALSE);
+    gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (combo_monitor), rend, "text", 1);
+    gtk_combo_box_set_model (GTK_COMBO_BOX (combo_monitor), GTK_TREE_MODEL (sortmons));
 
-        gtk_widget_show (GTK_WIDGET (toggle_same));
-    }
-    else
-    {
-        gtk_widget_hide (GTK_WIDGET (gtk_builder_get_object (builder, "hbox10")));
-    }
+    box_monitor = (GtkWidget *) gtk_builder_get_object (builder, "hbox10");
+    show_desktop_monitors ();
 }
 
 /* End of file */
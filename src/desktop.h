@@ -41,7 +41,11 @@ extern char *pcmanfm_file (gboolean global, int desktop, gboolean write);
 extern char *pcmanfm_g_file (gboolean global);
 extern void save_pcman_settings (int desktop);
 extern void save_pcman_g_settings (void);
+extern void block_desktop_monitor (gboolean block);
+extern void show_desktop_monitors (void);
 extern void set_desktop_controls (void);
+extern void remap_desktops (const int *map, int old_n);
+extern void load_desktop_settings (void);
 extern void load_desktop_tab (GtkBuilder *builder);
 
 /* End of file */
@@ -0,0 +1,349 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <string.h>
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+
+#include "files.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define KF_FLAGS (G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS)
+
+typedef struct {
+    GKeyFile *kf;
+    gboolean present;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+    char *digest;           /* of the contents on disk, if known */
+} KeyFileEntry;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Parsed key files, indexed by path */
+static GHashTable *key_files;
+
+/* Writes made, those skipped as the file already held the same bytes, and
+ * those synced to disk one by one */
+static unsigned int writes_done, writes_skipped, writes_synced;
+
+/* Set while writes are left for one sync at the end of a commit, rather than
+ * each being synced as it is made */
+static gboolean deferred;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static void free_entry (gpointer data);
+static void stamp_entry (KeyFileEntry *entry, struct stat *st, gboolean exists);
+static gboolean entry_valid (KeyFileEntry *entry, struct stat *st, gboolean exists);
+static char *digest (const char *data, gsize len);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static void free_entry (gpointer data)
+{
+    KeyFileEntry *entry = (KeyFileEntry *) data;
+
+    g_key_file_free (entry->kf);
+    g_free (entry->digest);
+    g_free (entry);
+}
+
+static void stamp_entry (KeyFileEntry *entry, struct stat *st, gboolean exists)
+{
+    if (exists)
+    {
+        entry->inode = st->st_ino;
+        entry->size = st->st_size;
+        entry->mtime = st->st_mtim;
+    }
+    else
+    {
+        entry->inode = 0;
+        entry->size = 0;
+        entry->mtime.tv_sec = 0;
+        entry->mtime.tv_nsec = 0;
+    }
+}
+
+static gboolean entry_valid (KeyFileEntry *entry, struct stat *st, gboolean exists)
+{
+    // a file which was missing is still valid if it is still missing
+    if (!exists) return entry->inode == 0;
+
+    return entry->inode == st->st_ino && entry->size == st->st_size
+        && entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static char *digest (const char *data, gsize len)
+{
+    return g_compute_checksum_for_data (G_CHECKSUM_SHA1, (const guchar *) data, len);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Writing files                                                              */
+/*----------------------------------------------------------------------------*/
+
+/* Writes a file unless it already holds exactly these bytes - the length is
+ * compared first, so the old contents are only read if it matches. Returns
+ * FALSE if the write fails */
+
+gboolean write_contents (const char *path, const char *data, gsize len)
+{
+    struct stat st;
+    char *old;
+    gsize old_len;
+    gboolean same = FALSE;
+
+    if (stat (path, &st) == 0 && S_ISREG (st.st_mode) && st.st_size == (off_t) len
+        && g_file_get_contents (path, &old, &old_len, NULL))
+    {
+        same = old_len == len && !memcmp (old, data, len);
+        g_free (old);
+    }
+
+    if (same)
+    {
+        writes_skipped++;
+        return TRUE;
+    }
+    writes_done++;
+
+    // still written to a temporary file and renamed, so never left half written
+    if (deferred) return g_file_set_contents_full (path, data, len, G_FILE_SET_CONTENTS_CONSISTENT, 0666, NULL);
+
+    writes_synced++;
+    return g_file_set_contents (path, data, len, NULL);
+}
+
+/* Leaves the syncing of writes to the caller, who must sync the filesystem
+ * once they are all made. Setting PIPANEL_STRICT_SYNC in the environment keeps
+ * every write synced as it is made */
+
+void defer_sync (gboolean defer)
+{
+    deferred = defer && !g_getenv ("PIPANEL_STRICT_SYNC");
+}
+
+/* Gives the number of files written, of writes skipped as unchanged, and of
+ * writes which were synced one by one */
+
+void write_counts (unsigned int *done, unsigned int *skipped, unsigned int *synced)
+{
+    *done = writes_done;
+    *skipped = writes_skipped;
+    *synced = writes_synced;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Key file cache                                                             */
+/*----------------------------------------------------------------------------*/
+
+/* Returns the parsed contents of a key file, which remain owned by the cache.
+ * The file is only reread if its inode, size or modification time has changed
+ * since it was last read or written. If the file does not exist or cannot be
+ * parsed, NULL is returned unless create is set, in which case an empty key
+ * file is returned to be filled in and saved. */
+
+GKeyFile *load_key_file (const char *path, gboolean create)
+{
+    KeyFileEntry *entry;
+    struct stat st;
+    gboolean exists;
+    char *str;
+    gsize len;
+
+    if (!key_files) key_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, free_entry);
+
+    exists = (stat (path, &st) == 0);
+
+    entry = g_hash_table_lookup (key_files, path);
+    if (entry && !entry_valid (entry, &st, exists))
+    {
+        g_hash_table_remove (key_files, path);
+        entry = NULL;
+    }
+
+    if (!entry)
+    {
+        entry = g_new0 (KeyFileEntry, 1);
+        entry->kf = g_key_file_new ();
+        if (exists && g_file_get_contents (path, &str, &len, NULL))
+        {
+            entry->present = g_key_file_load_from_data (entry->kf, str, len, KF_FLAGS, NULL);
+            entry->digest = digest (str, len);
+            g_free (str);
+        }
+        stamp_entry (entry, &st, exists);
+        g_hash_table_insert (key_files, g_strdup (path), entry);
+    }
+
+    if (!entry->present && !create) return NULL;
+    return entry->kf;
+}
+
+/* Writes the cached contents of a key file back to disk. If the file is as
+ * it was last read or written, and the new contents are the same length and
+ * digest, nothing is written */
+
+gboolean save_key_file (const char *path)
+{
+    KeyFileEntry *entry;
+    struct stat st;
+    char *str, *dig;
+    gsize len;
+    gboolean res;
+
+    if (!key_files || !(entry = g_hash_table_lookup (key_files, path))) return FALSE;
+
+    str = g_key_file_to_data (entry->kf, &len, NULL);
+    dig = digest (str, len);
+
+    if (entry->digest && stat (path, &st) == 0 && entry_valid (entry, &st, TRUE)
+        && entry->size == (off_t) len && !strcmp (entry->digest, dig))
+    {
+        writes_skipped++;
+        g_free (dig);
+        g_free (str);
+        return TRUE;
+    }
+
+    res = write_contents (path, str, len);
+    g_free (str);
+
+    if (res && stat (path, &st) == 0)
+    {
+        entry->present = TRUE;
+        stamp_entry (entry, &st, TRUE);
+        g_free (entry->digest);
+        entry->digest = dig;
+    }
+    else
+    {
+        g_hash_table_remove (key_files, path);
+        g_free (dig);
+    }
+
+    return res;
+}
+
+void free_key_files (void)
+{
+    if (key_files) g_hash_table_destroy (key_files);
+    key_files = NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* File stamps                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Returns a string identifying the current state of a file - its inode, size
+ * and modification time - for use as a cache key. A missing file gives "0". */
+
+char *file_stamp (const char *path)
+{
+    struct stat st;
+
+    if (stat (path, &st)) return g_strdup ("0");
+    return g_strdup_printf ("%lu:%ld:%ld.%09ld", (unsigned long) st.st_ino, (long) st.st_size,
+        (long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+}
+
+/* Adds an entry of the form "<stamp> <path>" to an array of stamps, taking
+ * ownership of the path */
+
+void add_file_stamp (GPtrArray *stamps, char *path)
+{
+    char *stamp = file_stamp (path);
+
+    g_ptr_array_add (stamps, g_strdup_printf ("%s %s", stamp, path));
+    g_free (stamp);
+    g_free (path);
+}
+
+/* Adds the stamp of each file in a directory whose name ends in suffix, but
+ * not in exclude, followed by the stamp of the directory itself, which
+ * changes when files are added, removed or replaced */
+
+void add_dir_stamps (GPtrArray *stamps, const char *path, const char *suffix, const char *exclude)
+{
+    GDir *dir;
+    const char *name;
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)))
+        {
+            if (!g_str_has_suffix (name, suffix)) continue;
+            if (exclude && g_str_has_suffix (name, exclude)) continue;
+            add_file_stamp (stamps, g_build_filename (path, name, NULL));
+        }
+        g_dir_close (dir);
+    }
+    add_file_stamp (stamps, g_strdup (path));
+}
+
+/*----------------------------------------------------------------------------*/
+/* Key file colours                                                           */
+/*----------------------------------------------------------------------------*/
+
+gboolean get_key_colour (GKeyFile *kf, const char *group, const char *key, GdkRGBA *colour)
+{
+    char *str = g_key_file_get_string (kf, group, key, NULL);
+    gboolean res = str && gdk_rgba_parse (colour, str);
+
+    g_free (str);
+    return res;
+}
+
+void set_key_colour (GKeyFile *kf, const char *group, const char *key, GdkRGBA *colour)
+{
+    char *str = gdk_rgba_to_string (colour);
+
+    g_key_file_set_string (kf, group, key, str);
+    g_free (str);
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
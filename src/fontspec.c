@@ -0,0 +1,510 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <pango/pangocairo.h>
+
+#include "pipanel.h"
+#include "files.h"
+
+#include "fontspec.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+typedef struct {
+    PangoWeight weight;
+    const char *labwc;
+    int qt5;
+} WeightMap;
+
+typedef struct {
+    const char *openbox;
+    const char *labwc;
+    int qt6;
+} StyleMap;
+
+#define QT5_DEFAULT_WEIGHT 50
+
+/* The faces of one family in the font index, and the description of each */
+typedef struct {
+    char **faces;
+    char **descs;
+} FamilyEntry;
+
+#define FONT_INDEX_VERSION 1
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Names and Qt5 values of the Pango weights - anything else is given no
+ * labwc weight and the normal Qt5 weight */
+static const WeightMap weights[] =
+{
+    { PANGO_WEIGHT_THIN,        "Thin",         0 },
+    { PANGO_WEIGHT_ULTRALIGHT,  "Ultralight",   12 },
+    { PANGO_WEIGHT_LIGHT,       "Light",        25 },
+    { PANGO_WEIGHT_SEMILIGHT,   "Semilight",    QT5_DEFAULT_WEIGHT },
+    { PANGO_WEIGHT_BOOK,        "Book",         QT5_DEFAULT_WEIGHT },
+    { PANGO_WEIGHT_NORMAL,      "Normal",       QT5_DEFAULT_WEIGHT },
+    { PANGO_WEIGHT_MEDIUM,      "Medium",       57 },
+    { PANGO_WEIGHT_SEMIBOLD,    "Semibold",     63 },
+    { PANGO_WEIGHT_BOLD,        "Bold",         75 },
+    { PANGO_WEIGHT_ULTRABOLD,   "Ultrabold",    81 },
+    { PANGO_WEIGHT_HEAVY,       "Heavy",        87 },
+    { PANGO_WEIGHT_ULTRAHEAVY,  "Ultraheavy",   87 }
+};
+
+/* Style names and Qt6 values, indexed by PangoStyle - openbox only knows italic */
+static const StyleMap styles[] =
+{
+    [PANGO_STYLE_NORMAL] =  { "Normal", "Normal",   0 },
+    [PANGO_STYLE_OBLIQUE] = { "Normal", "Oblique",  2 },
+    [PANGO_STYLE_ITALIC] =  { "Italic", "Italic",   1 }
+};
+
+/* The most recently parsed font */
+static FontSpec spec;
+
+/* Installed families, keyed by casefolded family name, and the fontconfig
+ * cache stamps from which they were listed */
+static GHashTable *font_index;
+static char **index_sources;
+static gboolean indexing;
+static void (*index_cb) (void);
+
+/* The thread building the index, a flag telling it to give up, and the idle
+ * callback it has queued - all are dealt with when the spec is freed, so that
+ * nothing runs after that */
+static GThread *index_thr;
+static gint index_cancel;
+static guint index_idle;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static const WeightMap *find_weight (PangoWeight weight);
+static const char *match_face (PangoFontDescription *pfd);
+static void clear_spec (void);
+static void parse_font (const char *desc, PangoFontFace *face);
+static char **font_index_sources (void);
+static char *font_index_file (void);
+static void free_family (gpointer data);
+static void install_index (GKeyFile *kf);
+static gpointer index_thread (gpointer data);
+static gboolean index_ready (gpointer data);
+static const char *index_face (PangoFontDescription *pfd);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static const WeightMap *find_weight (PangoWeight weight)
+{
+    int i;
+
+    for (i = 0; i < G_N_ELEMENTS (weights); i++)
+        if (weights[i].weight == weight) return &weights[i];
+    return NULL;
+}
+
+static const char *match_face (PangoFontDescription *pfd)
+{
+    PangoContext *ctx;
+    PangoFont *font;
+    const char *name;
+
+    // use the index if it has been loaded, as that needs no font to be opened
+    name = index_face (pfd);
+    if (name) return name;
+    name = "Regular";
+
+    // otherwise ask pango for the face which best matches the description
+    ctx = gdk_pango_context_get ();
+    font = pango_context_load_font (ctx, pfd);
+    if (font)
+    {
+        name = pango_font_face_get_face_name (pango_font_get_face (font));
+        g_object_unref (font);
+    }
+    g_object_unref (ctx);
+
+    return name;
+}
+
+static void clear_spec (void)
+{
+    g_free (spec.desc);
+    g_free (spec.family);
+    g_free (spec.qt5);
+    g_free (spec.qt6);
+    memset (&spec, 0, sizeof (FontSpec));
+}
+
+static void parse_font (const char *desc, PangoFontFace *face)
+{
+    PangoFontDescription *pfd;
+    PangoStyle style;
+    const WeightMap *wmap;
+    const char *face_name;
+    int height;
+
+    clear_spec ();
+
+    pfd = pango_font_description_from_string (desc);
+    spec.desc = g_strdup (desc);
+    spec.family = g_strdup (pango_font_description_get_family (pfd));
+    spec.size = pango_font_description_get_size (pfd) / (pango_font_description_get_size_is_absolute (pfd) ? 1 : PANGO_SCALE);
+    sprintf (spec.size_str, "%d", spec.size);
+    spec.weight = pango_font_description_get_weight (pfd);
+    spec.style = pango_font_description_get_style (pfd);
+
+    // height in pixels, assuming 96dpi for point sizes
+    height = pango_font_description_get_size (pfd);
+    if (!pango_font_description_get_size_is_absolute (pfd)) height = height * 4 / 3;
+    spec.pixel_size = height / PANGO_SCALE;
+
+    // window manager encodings
+    style = spec.style < G_N_ELEMENTS (styles) ? spec.style : PANGO_STYLE_NORMAL;
+    wmap = find_weight (spec.weight);
+    spec.openbox_weight = spec.weight == PANGO_WEIGHT_BOLD ? "Bold" : "Normal";
+    spec.openbox_style = styles[style].openbox;
+    spec.labwc_weight = wmap ? wmap->labwc : NULL;
+    spec.labwc_style = styles[style].labwc;
+
+    // Qt encodings - Qt5 also names the face
+    face_name = face ? pango_font_face_get_face_name (face) : match_face (pfd);
+    spec.qt5 = g_strdup_printf ("\"%s,%d,-1,5,%d,0,0,0,0,0,%s\"", spec.family, spec.size,
+        wmap ? wmap->qt5 : QT5_DEFAULT_WEIGHT, face_name);
+    spec.qt6 = g_strdup_printf ("\"%s,%d,-1,5,%d,%d,0,0,0,0,0,0,0,0,0,1\"", spec.family, spec.size,
+        spec.weight, styles[style].qt6);
+
+    pango_font_description_free (pfd);
+}
+
+/* The index is rebuilt whenever fc-cache replaces a cache file, which changes
+ * the stamp of its directory */
+
+static char **font_index_sources (void)
+{
+    GPtrArray *sources = g_ptr_array_new ();
+
+    add_file_stamp (sources, g_strdup ("/var/cache/fontconfig"));
+    add_file_stamp (sources, g_build_filename (g_get_user_cache_dir (), "fontconfig", NULL));
+
+    g_ptr_array_add (sources, NULL);
+    return (char **) g_ptr_array_free (sources, FALSE);
+}
+
+static char *font_index_file (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "pipanel", "fonts.conf", NULL);
+}
+
+static void free_family (gpointer data)
+{
+    FamilyEntry *entry = (FamilyEntry *) data;
+
+    g_strfreev (entry->faces);
+    g_strfreev (entry->descs);
+    g_free (entry);
+}
+
+static void install_index (GKeyFile *kf)
+{
+    FamilyEntry *entry;
+    char **families, *key;
+    gsize i, n, nfaces, ndescs;
+
+    if (font_index) g_hash_table_destroy (font_index);
+    font_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, free_family);
+    g_strfreev (index_sources);
+    index_sources = g_key_file_get_string_list (kf, "cache", "sources", NULL, NULL);
+
+    families = g_key_file_get_string_list (kf, "index", "families", &n, NULL);
+    for (i = 0; i < n; i++)
+    {
+        entry = g_new0 (FamilyEntry, 1);
+        key = g_strdup_printf ("faces%lu", (unsigned long) i);
+        entry->faces = g_key_file_get_string_list (kf, "index", key, &nfaces, NULL);
+        g_free (key);
+        key = g_strdup_printf ("descs%lu", (unsigned long) i);
+        entry->descs = g_key_file_get_string_list (kf, "index", key, &ndescs, NULL);
+        g_free (key);
+
+        if (entry->faces && entry->descs && nfaces == ndescs)
+            g_hash_table_insert (font_index, g_utf8_casefold (families[i], -1), entry);
+        else free_family (entry);
+    }
+    g_strfreev (families);
+}
+
+/* Lists every face of every family - this is what makes opening a font
+ * chooser slow, so it is done with a font map of its own off the main thread */
+
+static gpointer index_thread (gpointer data)
+{
+    char **sources = (char **) data;
+    PangoFontMap *map;
+    PangoFontFamily **families;
+    PangoFontFace **faces;
+    PangoFontDescription *pfd;
+    GKeyFile *kf;
+    const char **names;
+    char **face_names, **descs, *key, *cache_file;
+    int i, j, nfam, nface;
+
+    kf = g_key_file_new ();
+    g_key_file_set_integer (kf, "cache", "version", FONT_INDEX_VERSION);
+    g_key_file_set_string_list (kf, "cache", "sources", (const char * const *) sources, g_strv_length (sources));
+    g_strfreev (sources);
+
+    map = pango_cairo_font_map_new ();
+    pango_font_map_list_families (map, &families, &nfam);
+    names = g_new0 (const char *, nfam + 1);
+    for (i = 0; i < nfam && !g_atomic_int_get (&index_cancel); i++)
+    {
+        names[i] = pango_font_family_get_name (families[i]);
+
+        pango_font_family_list_faces (families[i], &faces, &nface);
+        face_names = g_new0 (char *, nface + 1);
+        descs = g_new0 (char *, nface + 1);
+        for (j = 0; j < nface; j++)
+        {
+            face_names[j] = g_strdup (pango_font_face_get_face_name (faces[j]));
+            pfd = pango_font_face_describe (faces[j]);
+            descs[j] = pango_font_description_to_string (pfd);
+            pango_font_description_free (pfd);
+        }
+        g_free (faces);
+
+        key = g_strdup_printf ("faces%d", i);
+        g_key_file_set_string_list (kf, "index", key, (const char * const *) face_names, nface);
+        g_free (key);
+        key = g_strdup_printf ("descs%d", i);
+        g_key_file_set_string_list (kf, "index", key, (const char * const *) descs, nface);
+        g_free (key);
+        g_strfreev (face_names);
+        g_strfreev (descs);
+    }
+    if (!g_atomic_int_get (&index_cancel))
+        g_key_file_set_string_list (kf, "index", "families", names, nfam);
+    g_free (names);
+    g_free (families);
+    g_object_unref (map);
+    if (g_atomic_int_get (&index_cancel))
+    {
+        g_key_file_free (kf);
+        return NULL;
+    }
+
+    cache_file = font_index_file ();
+    check_directory (cache_file);
+    g_key_file_save_to_file (kf, cache_file, NULL);
+    g_free (cache_file);
+
+    index_idle = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, index_ready, kf, (GDestroyNotify) g_key_file_free);
+    return NULL;
+}
+
+static gboolean index_ready (gpointer data)
+{
+    GKeyFile *kf = (GKeyFile *) data;
+
+    // the thread has finished with index_idle once it has been joined
+    g_thread_join (index_thr);
+    index_thr = NULL;
+    index_idle = 0;
+
+    install_index (kf);
+    indexing = FALSE;
+
+    if (index_cb) index_cb ();
+    return FALSE;
+}
+
+/* Finds the indexed face of a family which best matches a description */
+
+static const char *index_face (PangoFontDescription *pfd)
+{
+    FamilyEntry *entry;
+    PangoFontDescription *fpfd, *best = NULL;
+    const char *family, *name = NULL;
+    char *key;
+    int i;
+
+    family = pango_font_description_get_family (pfd);
+    if (!font_index || !family) return NULL;
+
+    key = g_utf8_casefold (family, -1);
+    entry = g_hash_table_lookup (font_index, key);
+    g_free (key);
+    if (!entry) return NULL;
+
+    for (i = 0; entry->faces[i]; i++)
+    {
+        fpfd = pango_font_description_from_string (entry->descs[i]);
+        if (pango_font_description_better_match (pfd, best, fpfd))
+        {
+            if (best) pango_font_description_free (best);
+            best = fpfd;
+            name = entry->faces[i];
+        }
+        else pango_font_description_free (fpfd);
+    }
+    if (best) pango_font_description_free (best);
+
+    return name;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Font specification                                                         */
+/*----------------------------------------------------------------------------*/
+
+/* Returns the parsed form of a font description, which is only parsed again
+ * when the description changes */
+
+const FontSpec *font_spec (const char *desc)
+{
+    if (!spec.desc || g_strcmp0 (spec.desc, desc)) parse_font (desc, NULL);
+    return &spec;
+}
+
+/* Parses a newly chosen font - the face given by the font chooser is used
+ * for the Qt5 face name rather than looking for the best match */
+
+const FontSpec *set_font_spec (const char *desc, PangoFontFace *face)
+{
+    parse_font (desc, face);
+    return &spec;
+}
+
+void free_font_spec (void)
+{
+    clear_spec ();
+
+    if (index_thr)
+    {
+        g_atomic_int_set (&index_cancel, 1);
+        g_thread_join (index_thr);
+        index_thr = NULL;
+        g_atomic_int_set (&index_cancel, 0);
+    }
+    if (index_idle) g_source_remove (index_idle);
+    index_idle = 0;
+    indexing = FALSE;
+
+    if (font_index) g_hash_table_destroy (font_index);
+    font_index = NULL;
+    g_strfreev (index_sources);
+    index_sources = NULL;
+    index_cb = NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Font index                                                                 */
+/*----------------------------------------------------------------------------*/
+
+/* Makes the index of installed families available - it is read from the cache
+ * if that was built from the current fontconfig caches, otherwise it is built
+ * on a background thread, and callback is called once it is ready */
+
+void load_font_index (void (*callback) (void))
+{
+    GKeyFile *kf;
+    char **sources, **cached, *cache_file;
+    gboolean valid = FALSE;
+
+    index_cb = callback;
+    if (indexing) return;
+
+    sources = font_index_sources ();
+    if (font_index && g_strv_equal ((const char * const *) index_sources, (const char * const *) sources))
+    {
+        g_strfreev (sources);
+        return;
+    }
+
+    cache_file = font_index_file ();
+    kf = g_key_file_new ();
+    if (g_key_file_load_from_file (kf, cache_file, G_KEY_FILE_NONE, NULL)
+        && g_key_file_get_integer (kf, "cache", "version", NULL) == FONT_INDEX_VERSION)
+    {
+        cached = g_key_file_get_string_list (kf, "cache", "sources", NULL, NULL);
+        valid = cached && g_strv_equal ((const char * const *) cached, (const char * const *) sources);
+        g_strfreev (cached);
+    }
+    g_free (cache_file);
+
+    if (valid)
+    {
+        install_index (kf);
+        g_key_file_free (kf);
+        g_strfreev (sources);
+        return;
+    }
+    g_key_file_free (kf);
+
+    indexing = TRUE;
+    index_thr = g_thread_new (NULL, index_thread, sources);
+}
+
+/* Returns the text to show for a font without opening a chooser, in the
+ * chooser's own "family face size" form once the face is known from the
+ * index, and as the bare description until then */
+
+char *font_label (const char *desc)
+{
+    PangoFontDescription *pfd;
+    const char *face;
+    char *label;
+    int size;
+
+    pfd = pango_font_description_from_string (desc);
+    face = index_face (pfd);
+    if (face)
+    {
+        size = pango_font_description_get_size (pfd) / (pango_font_description_get_size_is_absolute (pfd) ? 1 : PANGO_SCALE);
+        label = g_strdup_printf ("%s %s %d", pango_font_description_get_family (pfd), face, size);
+    }
+    else label = g_strdup (desc);
+    pango_font_description_free (pfd);
+
+    return label;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
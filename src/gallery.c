@@ -0,0 +1,394 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+
+#include "gallery.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* Largest dimension of a "normal" thumbnail in the freedesktop thumbnail spec */
+#define THUMB_SIZE 128
+
+#define WALLPAPER_DIR "/usr/share/rpd-wallpaper"
+
+/* Gallery model columns */
+enum {
+    GALLERY_PIXBUF,
+    GALLERY_NAME,
+    GALLERY_PATH,
+    GALLERY_N_COLS
+};
+
+/* A thumbnail to be made on the worker pool */
+typedef struct {
+    char *path;
+    char *uri;
+    char *thumb;
+    gint64 mtime;
+    int generation;
+    GtkTreeRowReference *row;
+    GdkPixbuf *pixbuf;
+    guint idle;
+} ThumbJob;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Worker pool which makes missing thumbnails */
+static GThreadPool *pool;
+
+/* Incremented when a gallery is closed, so that its outstanding jobs are dropped */
+static int generation;
+
+/* Finished jobs waiting for the main loop - removed when the gallery is freed,
+ * so that none can run after it */
+static GSList *ready;
+static GMutex ready_lock;
+
+/* Model of the open gallery */
+static GtkListStore *store;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static char *thumb_path (const char *uri);
+static GdkPixbuf *load_thumbnail (const char *thumb, const char *uri, gint64 mtime);
+static GdkPixbuf *make_thumbnail (ThumbJob *job);
+static void free_job (ThumbJob *job);
+static void thumb_worker (gpointer data, gpointer user_data);
+static gboolean thumb_ready (gpointer data);
+static void add_picture (const char *path, gint64 mtime);
+static void add_folder (const char *dir);
+static void select_picture (GtkIconView *view, const char *path);
+static void on_item_activated (GtkIconView *view, GtkTreePath *tp, gpointer data);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Thumbnail cache                                                            */
+/*----------------------------------------------------------------------------*/
+
+/* Thumbnails are shared with file managers and image viewers, so they are
+ * stored as the freedesktop thumbnail spec requires - a PNG named from the
+ * MD5 of the picture's URI, which records that URI and the picture's mtime */
+
+static char *thumb_path (const char *uri)
+{
+    char *md5, *name, *path;
+
+    md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+    name = g_strconcat (md5, ".png", NULL);
+    path = g_build_filename (g_get_user_cache_dir (), "thumbnails", "normal", name, NULL);
+    g_free (name);
+    g_free (md5);
+    return path;
+}
+
+static GdkPixbuf *load_thumbnail (const char *thumb, const char *uri, gint64 mtime)
+{
+    GdkPixbuf *pixbuf;
+    char *str;
+
+    pixbuf = gdk_pixbuf_new_from_file (thumb, NULL);
+    if (!pixbuf) return NULL;
+
+    // a thumbnail is stale if the picture has been modified since it was made
+    str = g_strdup_printf ("%" G_GINT64_FORMAT, mtime);
+    if (g_strcmp0 (gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::URI"), uri)
+        || g_strcmp0 (gdk_pixbuf_get_option (pixbuf, "tEXt::Thumb::MTime"), str))
+        g_clear_object (&pixbuf);
+    g_free (str);
+
+    return pixbuf;
+}
+
+static GdkPixbuf *make_thumbnail (ThumbJob *job)
+{
+    GdkPixbuf *pixbuf, *thumb;
+    char *tmp, *mtime;
+    int width, height;
+
+    // loading at scale lets the JPEG loader decode at 1/2, 1/4 or 1/8 size
+    // rather than decoding the full picture and scaling it down afterwards -
+    // a picture already small enough is loaded as it is, never enlarged
+    if (!gdk_pixbuf_get_file_info (job->path, &width, &height)) return NULL;
+    if (width > THUMB_SIZE || height > THUMB_SIZE)
+        pixbuf = gdk_pixbuf_new_from_file_at_scale (job->path, THUMB_SIZE, THUMB_SIZE, TRUE, NULL);
+    else pixbuf = gdk_pixbuf_new_from_file (job->path, NULL);
+    if (!pixbuf) return NULL;
+    thumb = gdk_pixbuf_apply_embedded_orientation (pixbuf);
+    g_object_unref (pixbuf);
+
+    // written under a temporary name and renamed, so no reader sees part of a file
+    check_directory (job->thumb);
+    tmp = g_strdup_printf ("%s.%p.tmp", job->thumb, (void *) job);
+    mtime = g_strdup_printf ("%" G_GINT64_FORMAT, job->mtime);
+    if (gdk_pixbuf_save (thumb, tmp, "png", NULL, "tEXt::Thumb::URI", job->uri,
+        "tEXt::Thumb::MTime", mtime, "tEXt::Software", "pipanel", NULL))
+    {
+        g_chmod (tmp, S_IRUSR | S_IWUSR);
+        if (g_rename (tmp, job->thumb)) g_remove (tmp);
+    }
+    else g_remove (tmp);
+    g_free (mtime);
+    g_free (tmp);
+
+    return thumb;
+}
+
+static void free_job (ThumbJob *job)
+{
+    g_free (job->path);
+    g_free (job->uri);
+    g_free (job->thumb);
+    gtk_tree_row_reference_free (job->row);
+    if (job->pixbuf) g_object_unref (job->pixbuf);
+    g_free (job);
+}
+
+static void thumb_worker (gpointer data, gpointer user_data)
+{
+    ThumbJob *job = (ThumbJob *) data;
+
+    // nothing to make if the gallery which asked for it has been closed
+    if (job->generation == g_atomic_int_get (&generation)) job->pixbuf = make_thumbnail (job);
+
+    // the row reference belongs to the main thread, so the job is finished there
+    g_mutex_lock (&ready_lock);
+    job->idle = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, thumb_ready, job, (GDestroyNotify) free_job);
+    ready = g_slist_prepend (ready, job);
+    g_mutex_unlock (&ready_lock);
+}
+
+static gboolean thumb_ready (gpointer data)
+{
+    ThumbJob *job = (ThumbJob *) data;
+    GtkTreePath *tp;
+    GtkTreeIter iter;
+
+    g_mutex_lock (&ready_lock);
+    ready = g_slist_remove (ready, job);
+    g_mutex_unlock (&ready_lock);
+
+    if (job->pixbuf && job->generation == g_atomic_int_get (&generation) && gtk_tree_row_reference_valid (job->row))
+    {
+        tp = gtk_tree_row_reference_get_path (job->row);
+        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, tp))
+            gtk_list_store_set (store, &iter, GALLERY_PIXBUF, job->pixbuf, -1);
+        gtk_tree_path_free (tp);
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Gallery contents                                                           */
+/*----------------------------------------------------------------------------*/
+
+/* Cached thumbnails are shown straight away - anything else is shown without
+ * a picture until a worker has made its thumbnail */
+
+static void add_picture (const char *path, gint64 mtime)
+{
+    GtkTreeIter iter;
+    GtkTreePath *tp;
+    GdkPixbuf *pixbuf;
+    ThumbJob *job;
+    char *uri, *thumb, *name;
+
+    uri = g_filename_to_uri (path, NULL, NULL);
+    if (!uri) return;
+    thumb = thumb_path (uri);
+    pixbuf = load_thumbnail (thumb, uri, mtime);
+
+    name = g_filename_display_basename (path);
+    gtk_list_store_insert_with_values (store, &iter, -1, GALLERY_PIXBUF, pixbuf, GALLERY_NAME, name,
+        GALLERY_PATH, path, -1);
+    g_free (name);
+
+    if (pixbuf)
+    {
+        g_object_unref (pixbuf);
+        g_free (thumb);
+        g_free (uri);
+        return;
+    }
+
+    job = g_new0 (ThumbJob, 1);
+    job->path = g_strdup (path);
+    job->uri = uri;
+    job->thumb = thumb;
+    job->mtime = mtime;
+    job->generation = g_atomic_int_get (&generation);
+    tp = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
+    job->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (store), tp);
+    gtk_tree_path_free (tp);
+
+    if (!pool) pool = g_thread_pool_new (thumb_worker, NULL, g_get_num_processors (), FALSE, NULL);
+    g_thread_pool_push (pool, job, NULL);
+}
+
+static void add_folder (const char *dir)
+{
+    GDir *d;
+    struct stat st;
+    const char *name;
+    char *path, *type;
+
+    d = g_dir_open (dir, 0, NULL);
+    if (!d) return;
+
+    while ((name = g_dir_read_name (d)))
+    {
+        if (name[0] == '.') continue;
+
+        type = g_content_type_guess (name, NULL, 0, NULL);
+        if (g_str_has_prefix (type, "image/"))
+        {
+            path = g_build_filename (dir, name, NULL);
+            if (stat (path, &st) == 0 && S_ISREG (st.st_mode)) add_picture (path, st.st_mtime);
+            g_free (path);
+        }
+        g_free (type);
+    }
+    g_dir_close (d);
+}
+
+static void select_picture (GtkIconView *view, const char *path)
+{
+    GtkTreeIter iter;
+    GtkTreePath *tp;
+    char *item;
+    gboolean valid;
+
+    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter);
+    while (valid)
+    {
+        gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, GALLERY_PATH, &item, -1);
+        if (!g_strcmp0 (item, path))
+        {
+            tp = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
+            gtk_icon_view_select_path (view, tp);
+            gtk_icon_view_scroll_to_path (view, tp, FALSE, 0, 0);
+            gtk_tree_path_free (tp);
+            g_free (item);
+            return;
+        }
+        g_free (item);
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (store), &iter);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Gallery dialog                                                             */
+/*----------------------------------------------------------------------------*/
+
+static void on_item_activated (GtkIconView *view, GtkTreePath *tp, gpointer data)
+{
+    gtk_dialog_response (GTK_DIALOG (data), GTK_RESPONSE_OK);
+}
+
+/* Shows the pictures in the system wallpaper folder and the user's Pictures
+ * folder, and returns the one chosen, or NULL if none was */
+
+char *choose_wallpaper (GtkWidget *parent, const char *current)
+{
+    GtkBuilder *builder;
+    GtkWidget *dlg, *view, *top;
+    GList *sel;
+    GtkTreeIter iter;
+    const char *pics;
+    char *path = NULL;
+
+    textdomain (GETTEXT_PACKAGE);
+    builder = gtk_builder_new_from_resource (UI_RESOURCE ("gallery.ui"));
+    dlg = (GtkWidget *) gtk_builder_get_object (builder, "gallery");
+    view = (GtkWidget *) gtk_builder_get_object (builder, "gallery_view");
+    g_object_unref (builder);
+
+    top = gtk_widget_get_toplevel (parent);
+    if (gtk_widget_is_toplevel (top)) gtk_window_set_transient_for (GTK_WINDOW (dlg), GTK_WINDOW (top));
+
+    store = gtk_list_store_new (GALLERY_N_COLS, GDK_TYPE_PIXBUF, G_TYPE_STRING, G_TYPE_STRING);
+    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (store), GALLERY_NAME, GTK_SORT_ASCENDING);
+    add_folder (WALLPAPER_DIR);
+    pics = g_get_user_special_dir (G_USER_DIRECTORY_PICTURES);
+    if (pics && g_strcmp0 (pics, WALLPAPER_DIR)) add_folder (pics);
+
+    gtk_icon_view_set_model (GTK_ICON_VIEW (view), GTK_TREE_MODEL (store));
+    gtk_icon_view_set_pixbuf_column (GTK_ICON_VIEW (view), GALLERY_PIXBUF);
+    gtk_icon_view_set_text_column (GTK_ICON_VIEW (view), GALLERY_NAME);
+    g_signal_connect (view, "item-activated", G_CALLBACK (on_item_activated), dlg);
+    select_picture (GTK_ICON_VIEW (view), current);
+
+    if (gtk_dialog_run (GTK_DIALOG (dlg)) == GTK_RESPONSE_OK)
+    {
+        sel = gtk_icon_view_get_selected_items (GTK_ICON_VIEW (view));
+        if (sel && gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, (GtkTreePath *) sel->data))
+            gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, GALLERY_PATH, &path, -1);
+        g_list_free_full (sel, (GDestroyNotify) gtk_tree_path_free);
+    }
+    gtk_widget_destroy (dlg);
+
+    // drop any thumbnails still to be made - those already made stay cached
+    g_atomic_int_inc (&generation);
+    g_object_unref (store);
+    store = NULL;
+
+    return path;
+}
+
+void free_gallery (void)
+{
+    GSList *jobs;
+
+    g_atomic_int_inc (&generation);
+    if (pool) g_thread_pool_free (pool, FALSE, TRUE);
+    pool = NULL;
+
+    // the workers have all finished, so nothing more can be added
+    jobs = ready;
+    ready = NULL;
+    while (jobs)
+    {
+        g_source_remove (((ThumbJob *) jobs->data)->idle);
+        jobs = g_slist_delete_link (jobs, jobs);
+    }
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,228 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "desktop.h"
+#include "taskbar.h"
+#include "system.h"
+#include "commit.h"
+
+#include "history.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* Most steps kept - the oldest is dropped beyond this */
+#define MAX_STEPS 100
+
+/* The Config after a change. A step is never altered once made; desktops
+ * which a change did not touch, and all strings, are shared with the step
+ * before */
+typedef struct {
+    Config conf;                /* desktops is unused */
+    DesktopConfig **desktops;   /* ndesks reference counted entries */
+} Step;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Steps from oldest to newest, and the one matching the files */
+static GPtrArray *steps;
+static int current;
+
+/* Set while a step is being applied, so that it is not recorded again */
+static gboolean applying;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static Step *new_step (const Step *prev);
+static void free_step (gpointer data);
+static gboolean apply_step (int index);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static Step *new_step (const Step *prev)
+{
+    Step *step = g_new0 (Step, 1);
+    int d;
+
+    step->conf = cur_conf;
+    step->conf.desktops = NULL;
+    step->conf.dirty = 0;
+
+    step->desktops = g_new (DesktopConfig *, ndesks);
+    for (d = 0; d < ndesks; d++)
+    {
+        if (prev && same_desktop (prev->desktops[d], &cur_conf.desktops[d]))
+            step->desktops[d] = g_rc_box_acquire (prev->desktops[d]);
+        else step->desktops[d] = g_rc_box_dup (sizeof (DesktopConfig), &cur_conf.desktops[d]);
+    }
+    return step;
+}
+
+static void free_step (gpointer data)
+{
+    Step *step = (Step *) data;
+    int d;
+
+    for (d = 0; d < ndesks; d++) g_rc_box_release (step->desktops[d]);
+    g_free (step->desktops);
+    g_free (step);
+}
+
+/* Makes a step the current state - only what differs from the files is written */
+
+static gboolean apply_step (int index)
+{
+    Step *step = g_ptr_array_index (steps, index);
+    DesktopConfig *desktops = cur_conf.desktops;
+    int d;
+
+    if (step->conf.darkmode != cur_conf.darkmode)
+    {
+        if (!system ("pgrep geany > /dev/null"))
+        {
+            message (_("The theme for Geany cannot be changed while it is open.\nPlease close it and try again."), TRUE);
+            return FALSE;
+        }
+
+        if (!system ("pgrep galculator > /dev/null"))
+        {
+            message (_("The theme for Calculator cannot be changed while it is open.\nPlease close it and try again."), TRUE);
+            return FALSE;
+        }
+    }
+
+    cur_conf = step->conf;
+    cur_conf.desktops = desktops;
+    for (d = 0; d < ndesks; d++) cur_conf.desktops[d] = *step->desktops[d];
+    current = index;
+
+    applying = TRUE;
+    mark_all_dirty ();
+    commit_changes ();
+    applying = FALSE;
+
+    set_desktop_controls ();
+    set_taskbar_controls ();
+    set_system_controls ();
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Undo history                                                               */
+/*----------------------------------------------------------------------------*/
+
+/* Starts a new history from the current state */
+
+void init_history (void)
+{
+    free_history ();
+    steps = g_ptr_array_new_with_free_func (free_step);
+    g_ptr_array_add (steps, new_step (NULL));
+    current = 0;
+}
+
+/* Adds the current state after a change, dropping anything which could have
+ * been redone */
+
+void record_step (void)
+{
+    if (!steps || applying) return;
+
+    if (current + 1 < steps->len) g_ptr_array_remove_range (steps, current + 1, steps->len - current - 1);
+    g_ptr_array_add (steps, new_step (g_ptr_array_index (steps, current)));
+    current++;
+
+    if (steps->len > MAX_STEPS)
+    {
+        g_ptr_array_remove_index (steps, 0);
+        current--;
+    }
+}
+
+gboolean undo_step (void)
+{
+    if (!steps || current == 0) return FALSE;
+    return apply_step (current - 1);
+}
+
+gboolean redo_step (void)
+{
+    if (!steps || current + 1 >= steps->len) return FALSE;
+    return apply_step (current + 1);
+}
+
+/* Follows the monitors changing, keeping every step - a desktop new to a step
+ * takes its settings from cur_conf */
+
+void remap_history (const int *map, int old_n)
+{
+    DesktopConfig **old;
+    Step *step;
+    int s, i, d;
+
+    if (!steps) return;
+
+    for (s = 0; s < steps->len; s++)
+    {
+        step = g_ptr_array_index (steps, s);
+        step->conf.monitor = remap_monitor (step->conf.monitor, map, old_n);
+        old = step->desktops;
+        step->desktops = g_new0 (DesktopConfig *, ndesks);
+        for (i = 0; i < old_n; i++)
+        {
+            if (map[i] >= 0) step->desktops[map[i]] = old[i];
+            else g_rc_box_release (old[i]);
+        }
+        for (d = 0; d < ndesks; d++)
+            if (!step->desktops[d]) step->desktops[d] = g_rc_box_dup (sizeof (DesktopConfig), &cur_conf.desktops[d]);
+        g_free (old);
+    }
+}
+
+void free_history (void)
+{
+    if (steps) g_ptr_array_free (steps, TRUE);
+    steps = NULL;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,289 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "files.h"
+
+#include "journal.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* The list of files in a journal - each line is the number of the saved copy,
+ * or - if there was no file, then the path relative to the home directory */
+#define JOURNAL_INDEX "files"
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Set while a journal is in place for the commit being written */
+static gboolean journalling;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static char *journal_dir (const char *suffix);
+static gboolean write_file (const char *path, const char *data, gsize len);
+static void sync_dir (const char *path);
+static void remove_dir (const char *path);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static char *journal_dir (const char *suffix)
+{
+    char *name = g_strconcat ("journal", suffix, NULL);
+    char *path = g_build_filename (g_get_user_cache_dir (), "pipanel", name, NULL);
+
+    g_free (name);
+    return path;
+}
+
+/* Writes a file without syncing it - sync_dir covers a set of them at once */
+
+static gboolean write_file (const char *path, const char *data, gsize len)
+{
+    FILE *fp = fopen (path, "wb");
+    gboolean res;
+
+    if (!fp) return FALSE;
+    res = fwrite (data, 1, len, fp) == len;
+    if (fclose (fp)) res = FALSE;
+    return res;
+}
+
+/* Flushes the whole filesystem holding a directory - one call for every file
+ * written, rather than an fsync for each */
+
+static void sync_dir (const char *path)
+{
+    int fd = open (path, O_RDONLY | O_DIRECTORY);
+
+    if (fd < 0) return;
+    syncfs (fd);
+    close (fd);
+}
+
+static void remove_dir (const char *path)
+{
+    GDir *dir = g_dir_open (path, 0, NULL);
+    const char *name;
+    char *file;
+
+    if (!dir) return;
+    while ((name = g_dir_read_name (dir)))
+    {
+        file = g_build_filename (path, name, NULL);
+        g_remove (file);
+        g_free (file);
+    }
+    g_dir_close (dir);
+    g_rmdir (path);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Commit journal                                                             */
+/*----------------------------------------------------------------------------*/
+
+/* Puts back the files from a journal left by a commit which did not finish, so
+ * that they match each other again. A journal which was still being made, or
+ * had been finished with, is just removed */
+
+void recover_journal (void)
+{
+    char *path, *index, *contents, **lines, *sep, *target, *copy, *data;
+    gsize len;
+    int i;
+
+    path = journal_dir (".new");
+    remove_dir (path);
+    g_free (path);
+
+    path = journal_dir (".old");
+    remove_dir (path);
+    g_free (path);
+
+    path = journal_dir ("");
+    index = g_build_filename (path, JOURNAL_INDEX, NULL);
+    if (g_file_get_contents (index, &contents, NULL, NULL))
+    {
+        lines = g_strsplit (contents, "\n", -1);
+        for (i = 0; lines[i]; i++)
+        {
+            if (!(sep = strchr (lines[i], ' '))) continue;
+            *sep++ = 0;
+
+            target = g_build_filename (g_get_home_dir (), sep, NULL);
+            if (!g_strcmp0 (lines[i], "-")) g_remove (target);
+            else
+            {
+                // the saved copy is moved back if it can be - a copy which has
+                // gone was moved back by a recovery which was itself interrupted
+                copy = g_build_filename (path, lines[i], NULL);
+                check_directory (target);
+                if (g_rename (copy, target) && g_file_get_contents (copy, &data, &len, NULL))
+                {
+                    write_file (target, data, len);
+                    g_free (data);
+                }
+                g_free (copy);
+            }
+            g_free (target);
+        }
+        g_strfreev (lines);
+        g_free (contents);
+
+        // the journal only goes once everything it put back is on disk
+        sync_dir (g_get_home_dir ());
+    }
+    g_free (index);
+    remove_dir (path);
+    g_free (path);
+}
+
+/* Saves a copy of each of the files a commit is about to change, so that it
+ * can be undone as a whole if it is interrupted. The journal is made under
+ * another name, synced once, then renamed into place - only then does it count.
+ * Only files in the home directory are covered, and not all of those:
+ *  - the greeter settings are just staged in /tmp by a commit and copied into
+ *    /etc after it
+ *  - the rendered wallpapers are named from their contents, and a desktop file
+ *    only points at one once it is complete
+ *  - the gsettings keys live in dconf's database, which its daemon writes - an
+ *    interrupted commit can leave these out of step with the files
+ *  - the alias themes' symlinks are only remade when the system theme changes,
+ *    and do not depend on the settings
+ *  - the Qt colour schemes other than pixtrix and pixonyx are plain copies of
+ *    the system ones
+ * Apart from the gsettings keys, none of these can be left half changed */
+
+void begin_journal (char **files)
+{
+    GString *index;
+    char *dir, *path, *target, *data;
+    gsize len;
+    gboolean res = TRUE;
+    int i;
+
+    if (!files[0]) return;
+
+    dir = journal_dir (".new");
+    remove_dir (dir);
+    g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+    index = g_string_new (NULL);
+    for (i = 0; files[i] && res; i++)
+    {
+        target = g_build_filename (g_get_home_dir (), files[i], NULL);
+        if (g_file_test (target, G_FILE_TEST_IS_REGULAR))
+        {
+            // a link costs nothing however large the file, and the writers only
+            // ever replace a file whole, so the original stays as it was
+            path = g_strdup_printf ("%s/%d", dir, i);
+            if (link (target, path))
+            {
+                if (g_file_get_contents (target, &data, &len, NULL))
+                {
+                    res = write_file (path, data, len);
+                    g_free (data);
+                }
+                else res = FALSE;
+            }
+            g_string_append_printf (index, "%d %s\n", i, files[i]);
+            g_free (path);
+        }
+        else g_string_append_printf (index, "- %s\n", files[i]);
+        g_free (target);
+    }
+
+    if (res)
+    {
+        path = g_build_filename (dir, JOURNAL_INDEX, NULL);
+        res = write_file (path, index->str, index->len);
+        g_free (path);
+    }
+    g_string_free (index, TRUE);
+
+    // without a complete journal the commit goes ahead unprotected, as before
+    if (res)
+    {
+        sync_dir (dir);
+        path = journal_dir ("");
+        if (g_rename (dir, path) == 0)
+        {
+            sync_dir (path);
+            journalling = TRUE;
+
+            // the journal covers the writes, so they need only be synced at the end
+            defer_sync (TRUE);
+        }
+        g_free (path);
+    }
+    if (!journalling) remove_dir (dir);
+    g_free (dir);
+}
+
+/* Marks the commit as complete once everything it wrote is on disk */
+
+void end_journal (void)
+{
+    char *path, *old;
+
+    if (!journalling) return;
+    journalling = FALSE;
+
+    sync_dir (g_get_home_dir ());
+    defer_sync (FALSE);
+
+    path = journal_dir ("");
+    old = journal_dir (".old");
+    if (g_rename (path, old) == 0) remove_dir (old);
+    else remove_dir (path);
+    g_free (old);
+    g_free (path);
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
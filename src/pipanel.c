@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ============================================================================*/
 
 #include <locale.h>
+#include <string.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
@@ -40,19 +41,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "taskbar.h"
 #include "system.h"
 #include "defaults.h"
+#include "files.h"
+#include "wmconf.h"
+#include "snapshot.h"
+#include "fontspec.h"
+#include "gallery.h"
+#include "wallpaper.h"
+#include "commit.h"
+#include "history.h"
+#include "journal.h"
 
 /*----------------------------------------------------------------------------*/
 /* Typedefs and macros                                                        */
 /*----------------------------------------------------------------------------*/
 
-#define MAX_X_DESKTOPS 2
+#define N_TABS 4
+#define N_SIZE_GROUPS 3
 
 /*----------------------------------------------------------------------------*/
 /* Global data                                                                */
 /*----------------------------------------------------------------------------*/
 
-static GtkBuilder *builder;
-
 /* Dialogs */
 static GtkWidget *main_dlg, *msg_dlg;
 
@@ -62,6 +71,9 @@ Config cur_conf;
 /* Flag to indicate window manager in use */
 wm_type wm;
 
+/* Pool of the strings held by Configs */
+static GHashTable *conf_strings;
+
 /* Monitor list for combos */
 static GtkListStore *mons;
 GtkTreeModel *sortmons;
@@ -69,17 +81,42 @@ GtkTreeModel *sortmons;
 /* Number of desktops */
 int ndesks;
 
+/* Monitor registry - names and per-output file paths, and lookup by name */
+MonitorInfo *monitors;
+static int n_monitors;
+static GHashTable *monitor_names;
+static gulong monitors_id;
+
 /* Is new theme available? */
 gboolean trix_theme = FALSE;
 
+/* Per-tab UI fragments - each is only built when its tab is first needed */
+static const struct
+{
+    const char *file;
+    const char *root;
+} tab_ui[N_TABS] =
+{
+    { UI_RESOURCE ("desktop.ui"), "vbox1" },
+    { UI_RESOURCE ("taskbar.ui"), "vbox2" },
+    { UI_RESOURCE ("system.ui"), "vbox3" },
+    { UI_RESOURCE ("defaults.ui"), "vbox4" }
+};
+static GtkWidget *tabs[N_TABS];
+
+/* Size groups which keep rows and controls aligned between tabs */
+static const char *size_group_ids[N_SIZE_GROUPS] = { "sg_rows", "sg_controls", "sg_radios" };
+static GtkSizeGroup *size_groups[N_SIZE_GROUPS];
+
 #ifndef PLUGIN_NAME
+static GtkBuilder *builder;
 static gulong draw_id;
 
 /* Starting tab value read from command line */
 static char *st_tab;
 
-/* Original theme in use */
-static int orig_darkmode;
+/* Settings in use at the start, which cancel goes back to */
+static Config orig_conf;
 #endif
 
 /*----------------------------------------------------------------------------*/
@@ -87,18 +124,27 @@ static int orig_darkmode;
 /*----------------------------------------------------------------------------*/
 
 static void update_greeter (void);
+static void free_conf_strings (void);
 static int n_desktops (void);
+static void free_monitors (void);
+static void on_monitors_changed (GdkScreen *screen, gpointer data);
 static gboolean ok_clicked (GtkButton *button, gpointer data);
 static void init_config (void);
+static void merge_size_group (GtkBuilder *tab_builder, int group);
+static GtkWidget *build_tab (int tab);
+static gboolean on_key_press (GtkWidget *widget, GdkEventKey *event, gpointer data);
 #ifndef PLUGIN_NAME
 static void backup_file (char *filepath);
 static void backup_config_files (void);
 static int restore_file (char *filepath);
-static int restore_config_files (void);
+static int restore_config_files (const ConfigPlan *plan);
 static gpointer restore_thread (gpointer ptr);
+static void save_and_quit (void);
 static gboolean ok_main (GtkButton *button, gpointer data);
 static gboolean cancel_main (GtkButton *button, gpointer data);
 static gboolean close_prog (GtkWidget *widget, GdkEvent *event, gpointer data);
+static void show_tab (GtkWidget *page, int tab);
+static void on_switch_page (GtkNotebook *notebook, GtkWidget *page, guint num, gpointer data);
 static gboolean init_window (gpointer data);
 static gboolean draw (GtkWidget *wid, cairo_t *cr, gpointer data);
 #endif
@@ -170,6 +216,116 @@ char *rgba_to_gdk_color_string (GdkRGBA *col)
     return g_strdup_printf ("#%02X%02X%02X", r, g, b);
 }
 
+/* Every string held in a Config is either a literal or a copy from this pool,
+ * so a Config can be overwritten or copied without freeing anything, and a
+ * value which is set again reuses its copy. The pool is freed as a whole */
+
+const char *conf_string (const char *str)
+{
+    char *copy;
+
+    if (!str) return NULL;
+    if (!conf_strings) conf_strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    copy = g_hash_table_lookup (conf_strings, str);
+    if (!copy)
+    {
+        copy = g_strdup (str);
+        g_hash_table_add (conf_strings, copy);
+    }
+    return copy;
+}
+
+const char *take_conf_string (char *str)
+{
+    const char *copy = conf_string (str);
+
+    g_free (str);
+    return copy;
+}
+
+static void free_conf_strings (void)
+{
+    if (conf_strings) g_hash_table_destroy (conf_strings);
+    conf_strings = NULL;
+}
+
+void alloc_config (Config *conf)
+{
+    g_free (conf->desktops);
+    conf->desktops = g_new0 (DesktopConfig, ndesks);
+}
+
+void copy_config (Config *to, const Config *from)
+{
+    DesktopConfig *desktops = to->desktops;
+
+    *to = *from;
+    to->desktops = desktops;
+    memcpy (to->desktops, from->desktops, ndesks * sizeof (DesktopConfig));
+}
+
+/* Works out where each of old_n desktops, held for the outputs named, goes
+ * now that the monitors have changed - -1 for those whose output has gone. On
+ * X, and with a common background, the files are per position, so each
+ * desktop stays where it is */
+
+int *map_desktops (const char **names, int old_n)
+{
+    int *map = g_new (int, old_n);
+    gboolean *taken = g_new0 (gboolean, ndesks);
+    int i, d;
+
+    for (i = 0; i < old_n; i++)
+    {
+        if (wm == WM_OPENBOX || cur_conf.common_bg) d = i < ndesks ? i : -1;
+        else d = monitor_index (names[i]);
+        if (d >= 0 && taken[d]) d = -1;
+        if (d >= 0) taken[d] = TRUE;
+        map[i] = d;
+    }
+    g_free (taken);
+    return map;
+}
+
+/* Returns where the taskbar's monitor goes as given by map_desktops - the
+ * first monitor if its output has gone */
+
+int remap_monitor (int monitor, const int *map, int old_n)
+{
+    if (monitor < 0 || monitor >= old_n || map[monitor] < 0) return 0;
+    return map[monitor];
+}
+
+/* Moves the desktops of a Config as given by map_desktops into an array of
+ * the current size, and its taskbar monitor with them - returns which of them
+ * were filled, the rest being left for the caller */
+
+gboolean *remap_config (Config *conf, const int *map, int old_n)
+{
+    DesktopConfig *old = conf->desktops;
+    gboolean *placed = g_new0 (gboolean, ndesks);
+    int i;
+
+    conf->monitor = remap_monitor (conf->monitor, map, old_n);
+    conf->desktops = NULL;
+    alloc_config (conf);
+    for (i = 0; i < old_n; i++)
+    {
+        if (map[i] < 0) continue;
+        conf->desktops[map[i]] = old[i];
+        placed[map[i]] = TRUE;
+    }
+    g_free (old);
+    return placed;
+}
+
+void free_config (Config *conf)
+{
+    g_free (conf->desktops);
+    memset (conf, 0, sizeof (Config));
+}
+
 static int n_desktops (void)
 {
     int n, m;
@@ -196,13 +352,7 @@ void check_directory (const char *path)
 
 const char *theme_name (int dark)
 {
-    if (dark == TEMP)
-    {
-        if (trix_theme)
-            return is_dark () ? "tPiXonyx" : "tPiXtrix";
-        else
-            return is_dark () ? "tPiXnoir" : "tPiXflat";
-    }
+    if (dark == TEMP) return alias_theme_name (is_dark ());
     else
     {
         if (trix_theme)
@@ -212,6 +362,143 @@ const char *theme_name (int dark)
     }
 }
 
+const char *alias_theme_name (int dark)
+{
+    if (trix_theme)
+        return dark ? "tPiXonyx" : "tPiXtrix";
+    else
+        return dark ? "tPiXnoir" : "tPiXflat";
+}
+
+/*----------------------------------------------------------------------------*/
+/* Monitor registry                                                           */
+/*----------------------------------------------------------------------------*/
+
+static void free_monitors (void)
+{
+    int i, global;
+
+    if (monitor_names) g_hash_table_destroy (monitor_names);
+    monitor_names = NULL;
+
+    if (!monitors) return;
+    for (i = 0; i < n_monitors; i++)
+    {
+        g_free (monitors[i].name);
+        for (global = 0; global < 2; global++)
+            g_free (monitors[i].pcman_file[global]);
+    }
+    g_free (monitors);
+    monitors = NULL;
+}
+
+/* Reads the connector names of the outputs, and works out which per-output
+ * pcmanfm files exist - called at startup, when monitors are plugged or
+ * unplugged, and after config files are deleted or restored */
+
+void update_monitors (void)
+{
+    GdkScreen *screen = gdk_display_get_default_screen (gdk_display_get_default ());
+    GdkRectangle geom;
+    char *fname;
+    int i, global;
+
+    free_monitors ();
+    monitors = g_new0 (MonitorInfo, ndesks);
+    n_monitors = ndesks;
+    monitor_names = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < ndesks; i++)
+    {
+        monitors[i].index = i;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        monitors[i].name = gdk_screen_get_monitor_plug_name (screen, i);
+
+        // size in device pixels, which is what a wallpaper is rendered at
+        gdk_screen_get_monitor_geometry (screen, i, &geom);
+        monitors[i].width = geom.width * gdk_screen_get_monitor_scale_factor (screen, i);
+        monitors[i].height = geom.height * gdk_screen_get_monitor_scale_factor (screen, i);
+#pragma GCC diagnostic pop
+        if (!monitors[i].name) continue;
+
+        if (!g_hash_table_contains (monitor_names, monitors[i].name))
+            g_hash_table_insert (monitor_names, monitors[i].name, GINT_TO_POINTER (i));
+
+        fname = g_strdup_printf ("desktop-items-%s.conf", monitors[i].name);
+        for (global = 0; global < 2; global++)
+        {
+            monitors[i].pcman_file[global] = g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "pcmanfm", "default", fname, NULL);
+            monitors[i].pcman_exists[global] = (access (monitors[i].pcman_file[global], F_OK) == 0);
+        }
+        g_free (fname);
+    }
+}
+
+const char *monitor_name (int index)
+{
+    if (index < 0 || index >= ndesks) return NULL;
+    return monitors[index].name;
+}
+
+int monitor_index (const char *name)
+{
+    gpointer val;
+
+    if (!monitor_names || !name) return -1;
+    if (!g_hash_table_lookup_extended (monitor_names, name, NULL, &val)) return -1;
+    return GPOINTER_TO_INT (val);
+}
+
+static void on_monitors_changed (GdkScreen *screen, gpointer data)
+{
+    char **names;
+    int *map, i, old_n = ndesks;
+#ifndef PLUGIN_NAME
+    gboolean *placed;
+#endif
+
+    names = g_new0 (char *, old_n + 1);
+    for (i = 0; i < old_n; i++) names[i] = g_strdup (monitors[i].name);
+
+    // there is a desktop for each monitor now connected
+    ndesks = n_desktops ();
+    update_monitors ();
+
+    // the lists are rebuilt without their handlers taking the emptied list as
+    // a choice; the tabs set their choices again once the settings have moved
+    block_desktop_monitor (TRUE);
+    block_taskbar_monitor (TRUE);
+    gtk_list_store_clear (mons);
+    for (i = 0; i < ndesks; i++)
+        gtk_list_store_insert_with_values (mons, NULL, i, 0, i, 1, monitors[i].name, -1);
+
+    // the desktop settings, and the taskbar's monitor, follow the outputs they belong to
+    map = map_desktops ((const char **) names, old_n);
+    update_desktop_defaults ();
+    remap_desktops (map, old_n);
+    set_taskbar_controls ();
+    show_desktop_monitors ();
+    show_taskbar_monitors ();
+    block_taskbar_monitor (FALSE);
+    block_desktop_monitor (FALSE);
+#ifndef PLUGIN_NAME
+    if (orig_conf.desktops)
+    {
+        placed = remap_config (&orig_conf, map, old_n);
+        for (i = 0; i < ndesks; i++)
+            if (!placed[i]) orig_conf.desktops[i] = cur_conf.desktops[i];
+        g_free (placed);
+    }
+#endif
+    g_free (map);
+    g_strfreev (names);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Greeter                                                                    */
+/*----------------------------------------------------------------------------*/
+
 static void update_greeter (void)
 {
     if (g_file_test (GREETER_TMP, G_FILE_TEST_IS_REGULAR))
@@ -231,7 +518,7 @@ void message (char *msg, gboolean ok)
     GtkBuilder *builder;
 
     textdomain (GETTEXT_PACKAGE);
-    builder = gtk_builder_new_from_file (PACKAGE_DATA_DIR "/ui/pipanel.ui");
+    builder = gtk_builder_new_from_resource (UI_RESOURCE ("modal.ui"));
 
     msg_dlg = (GtkWidget *) gtk_builder_get_object (builder, "modal");
     if (main_dlg) gtk_window_set_transient_for (GTK_WINDOW (msg_dlg), GTK_WINDOW (main_dlg));
@@ -268,47 +555,118 @@ static gboolean ok_clicked (GtkButton *button, gpointer data)
 static void init_config (void)
 {
     int i;
-    char *buf;
     struct stat st;
 
+    // put back any files left half written by an interrupted commit
+    recover_journal ();
+
     // check to see if new theme is installed
     if (stat ("/usr/share/themes/PiXtrix", &st) == 0) trix_theme = TRUE;
 
     // find the number of monitors
     ndesks = n_desktops ();
-    if (ndesks > MAX_DESKTOPS) ndesks = MAX_DESKTOPS;
-    if (wm == WM_OPENBOX && ndesks > MAX_X_DESKTOPS) ndesks = MAX_X_DESKTOPS;
+    alloc_config (&cur_conf);
+
+    // build the monitor registry, and keep it up to date
+    update_monitors ();
+    monitors_id = g_signal_connect (gdk_display_get_default_screen (gdk_display_get_default ()), "monitors-changed",
+        G_CALLBACK (on_monitors_changed), NULL);
 
     // load monitor names into list store
     mons = gtk_list_store_new (2, G_TYPE_INT, G_TYPE_STRING);
     for (i = 0; i < ndesks; i++)
-    {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-        buf = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), i);
-#pragma GCC diagnostic pop
-        gtk_list_store_insert_with_values (mons, NULL, i, 0, i, 1, buf, -1);
-        g_free (buf);
-    }
+        gtk_list_store_insert_with_values (mons, NULL, i, 0, i, 1, monitors[i].name, -1);
     sortmons = gtk_tree_model_sort_new_with_model (GTK_TREE_MODEL (mons));
     gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (sortmons), 1, GTK_SORT_ASCENDING);
 
     // create default data structures
     create_defaults ();
 
-    // load current state and controls
-    load_desktop_tab (builder);
-    load_taskbar_tab (builder);
-    load_system_tab (builder);
-    load_defaults_tab (builder);
+    // load current state - the controls are set up as each tab is built
+    load_desktop_settings ();
+    load_taskbar_settings ();
+    load_system_settings ();
+    save_snapshot ();
 
     // create session file to be tracked
     init_session (theme_name (cur_conf.darkmode));
 
-    // set up controls to match current state of data
-    set_desktop_controls ();
-    set_taskbar_controls ();
-    set_system_controls ();
+    // only changes from the loaded state are written out
+    init_commit ();
+}
+
+/*----------------------------------------------------------------------------*/
+/* Tab construction                                                           */
+/*----------------------------------------------------------------------------*/
+
+static void merge_size_group (GtkBuilder *tab_builder, int group)
+{
+    GtkSizeGroup *sg;
+    GSList *l;
+
+    sg = (GtkSizeGroup *) gtk_builder_get_object (tab_builder, size_group_ids[group]);
+    if (!sg) return;
+
+    // the first tab built supplies the shared group; later tabs join it
+    if (!size_groups[group]) size_groups[group] = g_object_ref (sg);
+    else for (l = gtk_size_group_get_widgets (sg); l; l = l->next)
+        gtk_size_group_add_widget (size_groups[group], GTK_WIDGET (l->data));
+}
+
+static GtkWidget *build_tab (int tab)
+{
+    GtkBuilder *tab_builder;
+    int i;
+
+    if (tabs[tab]) return tabs[tab];
+
+    textdomain (GETTEXT_PACKAGE);
+    tab_builder = gtk_builder_new_from_resource (tab_ui[tab].file);
+
+    switch (tab)
+    {
+        case 0 :    load_desktop_tab (tab_builder);
+                    set_desktop_controls ();
+                    break;
+        case 1 :    load_taskbar_tab (tab_builder);
+                    set_taskbar_controls ();
+                    break;
+        case 2 :    load_system_tab (tab_builder);
+                    set_system_controls ();
+                    break;
+        case 3 :    load_defaults_tab (tab_builder);
+                    break;
+    }
+
+    for (i = 0; i < N_SIZE_GROUPS; i++) merge_size_group (tab_builder, i);
+
+    // keep the tab alive once the builder has gone
+    tabs[tab] = (GtkWidget *) g_object_ref (gtk_builder_get_object (tab_builder, tab_ui[tab].root));
+    g_object_unref (tab_builder);
+
+    g_signal_connect (tabs[tab], "key-press-event", G_CALLBACK (on_key_press), NULL);
+
+    return tabs[tab];
+}
+
+/* Ctrl+Z undoes the last change on any tab, and Ctrl+Shift+Z or Ctrl+Y redoes it */
+
+static gboolean on_key_press (GtkWidget *widget, GdkEventKey *event, gpointer data)
+{
+    GdkModifierType mods = event->state & gtk_accelerator_get_default_mod_mask ();
+
+    if (mods == GDK_CONTROL_MASK && (event->keyval == GDK_KEY_z || event->keyval == GDK_KEY_Z))
+    {
+        undo_step ();
+        return TRUE;
+    }
+    if ((mods == (GDK_CONTROL_MASK | GDK_SHIFT_MASK) && (event->keyval == GDK_KEY_z || event->keyval == GDK_KEY_Z))
+        || (mods == GDK_CONTROL_MASK && (event->keyval == GDK_KEY_y || event->keyval == GDK_KEY_Y)))
+    {
+        redo_step ();
+        return TRUE;
+    }
+    return FALSE;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -332,14 +690,13 @@ void init_plugin (GtkWidget *)
     else wm = WM_OPENBOX;
 
     main_dlg = NULL;
-    builder = gtk_builder_new_from_file (PACKAGE_DATA_DIR "/ui/pipanel.ui");
 
     init_config ();
 }
 
 int plugin_tabs (void)
 {
-    return 4;
+    return N_TABS;
 }
 
 const char *tab_name (int tab)
@@ -378,30 +735,8 @@ const char *tab_id (int tab)
 
 GtkWidget *get_tab (int tab)
 {
-    GtkWidget *window, *plugin;
-
-    window = (GtkWidget *) gtk_builder_get_object (builder, "notebook1");
-    switch (tab)
-    {
-        case 0 :
-            plugin = (GtkWidget *) gtk_builder_get_object (builder, "vbox1");
-            break;
-        case 1 :
-            plugin = (GtkWidget *) gtk_builder_get_object (builder, "vbox2");
-            break;
-        case 2 :
-            plugin = (GtkWidget *) gtk_builder_get_object (builder, "vbox3");
-            break;
-        case 3 :
-            plugin = (GtkWidget *) gtk_builder_get_object (builder, "vbox4");
-            break;
-        default :
-            plugin = NULL;
-    }
-
-    gtk_container_remove (GTK_CONTAINER (window), plugin);
-
-    return plugin;
+    if (tab < 0 || tab >= N_TABS) return NULL;
+    return build_tab (tab);
 }
 
 gboolean reboot_needed (void)
@@ -412,7 +747,25 @@ gboolean reboot_needed (void)
 
 void free_plugin (void)
 {
-    g_object_unref (builder);
+    int i;
+
+    g_signal_handler_disconnect (gdk_display_get_default_screen (gdk_display_get_default ()), monitors_id);
+    free_monitors ();
+    for (i = 0; i < N_TABS; i++)
+        if (tabs[i]) g_object_unref (tabs[i]);
+    for (i = 0; i < N_SIZE_GROUPS; i++)
+        if (size_groups[i]) g_object_unref (size_groups[i]);
+    free_key_files ();
+    free_snapshot ();
+    free_font_spec ();
+    free_gallery ();
+    free_wallpapers ();
+    free_wm_config ();
+    free_history ();
+    free_commit ();
+    free_defaults ();
+    free_config (&cur_conf);
+    free_conf_strings ();
 }
 
 #else
@@ -438,7 +791,7 @@ static void backup_file (char *filepath)
 
 static void backup_config_files (void)
 {
-    char *path, *monname;
+    char *path, **files;
     int i;
 
     // delete any old backups and create a new backup directory
@@ -447,55 +800,9 @@ static void backup_config_files (void)
     g_mkdir_with_parents (path, S_IRUSR | S_IWUSR | S_IXUSR);
     g_free (path);
 
-    backup_file (".config/openbox/rpd-rc.xml");
-    backup_file (".config/lxsession/rpd-x/desktop.conf");
-    backup_file (".config/lxpanel-pi/panels/panel");
-    backup_file (".config/pcmanfm/default/pcmanfm.conf");
-
-    for (i = 0; i < ndesks; i++)
-    {
-        path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%d.conf", i);
-        backup_file (path);
-        g_free (path);
-
-        if (wm != WM_OPENBOX)
-        {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-            monname = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), i);
-#pragma GCC diagnostic pop
-            path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%s.conf", monname);
-            backup_file (path);
-            g_free (path);
-            g_free (monname);
-        }
-    }
-
-    path = g_build_filename (".local/share/themes", theme_name (LIGHT), "gtk-3.0/gtk.css", NULL);
-    backup_file (path);
-    g_free (path);
-
-    path = g_build_filename (".local/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
-    backup_file (path);
-    g_free (path);
-
-    backup_file (".config/wf-panel-pi/wf-panel-pi.ini");
-    backup_file (".config/libfm/libfm.conf");
-    backup_file (".config/gtk-3.0/gtk.css");
-    backup_file (".config/qt5ct/qt5ct.conf");
-    backup_file (".config/qt6ct/qt6ct.conf");
-    backup_file (".config/xsettingsd/xsettingsd.conf");
-    backup_file (".config/wayfire.ini");
-    backup_file (".config/labwc/themerc-override");
-    backup_file (".config/labwc/rc.xml");
-    backup_file (".config/labwc/environment");
-    backup_file (".gtkrc-2.0");
-
-    // app-specific
-    backup_file (".config/lxterminal/lxterminal.conf");
-    backup_file (".config/libreoffice/4/user/registrymodifications.xcu");
-    backup_file (".config/geany/geany.conf");
-    backup_file (".config/galculator/galculator.conf");
+    files = plan_files (NULL, FALSE);
+    for (i = 0; files[i]; i++) backup_file (files[i]);
+    g_strfreev (files);
 }
 
 static int restore_file (char *filepath)
@@ -521,77 +828,42 @@ static int restore_file (char *filepath)
     return changed;
 }
 
-static int restore_config_files (void)
+static int restore_config_files (const ConfigPlan *plan)
 {
-    char *path, *monname;
+    char **files;
     int i, changed = 0;
 
-    restore_file (".config/openbox/rpd-rc.xml");
-    if (restore_file (".config/lxsession/rpd-x/desktop.conf")) changed = 1;
-    if (restore_file (".config/lxpanel-pi/panels/panel")) changed = 1;
-    if (restore_file (".config/pcmanfm/default/pcmanfm.conf")) changed = 1;
-
-    for (i = 0; i < ndesks; i++)
-    {
-        path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%d.conf", i);
-        if (restore_file (path)) changed = 1;
-        g_free (path);
-
-        if (wm != WM_OPENBOX)
-        {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-            monname = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), i);
-#pragma GCC diagnostic pop
-            path = g_strdup_printf (".config/pcmanfm/default/desktop-items-%s.conf", monname);
-            if (restore_file (path)) changed = 1;
-            g_free (path);
-            g_free (monname);
-        }
-    }
-
-    path = g_build_filename (".local/share/themes", theme_name (LIGHT), "gtk-3.0/gtk.css", NULL);
-    if (restore_file (path)) changed = 1;
-    g_free (path);
-
-    path = g_build_filename (".local/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
-    if (restore_file (path)) changed = 1;
-    g_free (path);
-
-    if (restore_file (".config/wf-panel-pi/wf-panel-pi.ini")) changed = 1;
-    if (restore_file (".config/libfm/libfm.conf")) changed = 1;
-    if (restore_file (".config/gtk-3.0/gtk.css")) changed = 1;
-    if (restore_file (".config/qt5ct/qt5ct.conf")) changed = 1;
-    if (restore_file (".config/qt6ct/qt6ct.conf")) changed = 1;
-    if (restore_file (".config/xsettingsd/xsettingsd.conf")) changed = 1;
-    if (restore_file (".config/wayfire.ini")) changed = 1;
-    if (restore_file (".config/labwc/themerc-override")) changed = 1;
-    if (restore_file (".config/labwc/rc.xml")) changed = 1;
-    if (restore_file (".config/labwc/environment")) changed = 1;
-    if (restore_file (".gtkrc-2.0")) changed = 1;
-
-    // app-specific
-    if (restore_file (".config/lxterminal/lxterminal.conf")) changed = 1;
-    if (restore_file (".config/libreoffice/4/user/registrymodifications.xcu")) changed = 1;
-    if (restore_file (".config/geany/geany.conf")) changed = 1;
-    if (restore_file (".config/galculator/galculator.conf")) changed = 1;
+    files = plan_files (plan, FALSE);
+    for (i = 0; files[i]; i++)
+        if (restore_file (files[i])) changed = 1;
+    g_strfreev (files);
 
     return changed;
 }
 
 static gpointer restore_thread (gpointer ptr)
 {
-    restore_gsettings ();
-    if (restore_config_files ())
+    ConfigPlan plan;
+
+    // staged changes were never written - only files which have been are restored
+    plan_changes (&plan, written_config (), &orig_conf, CONF_ALL);
+    if (plan.actions & W_SESSION) restore_gsettings ();
+    if (restore_config_files (&plan))
     {
-        cur_conf.darkmode = orig_darkmode;
-        set_theme (theme_name (TEMP));
-        reload_session ();
-        reload_panel ();
-        reload_desktop ();
-        reload_theme (TRUE);
+        cur_conf.darkmode = orig_conf.darkmode;
+        if (plan.actions & R_SESSION) reload_session ();
+        if (plan.actions & R_PANEL) reload_panel ();
+        if (plan.actions & R_DESKTOP) reload_desktop ();
+        if (plan.actions & R_THEME)
+        {
+            invalidate_dark_mode ();
+            set_theme (theme_name (TEMP));
+            reload_theme (TRUE);
+        }
+        else gtk_main_quit ();
     }
     else gtk_main_quit ();
+    free_plan (&plan);
     return NULL;
 }
 
@@ -599,16 +871,39 @@ static gpointer restore_thread (gpointer ptr)
 /* Main window button handlers                                                */
 /*----------------------------------------------------------------------------*/
 
-static gboolean ok_main (GtkButton *button, gpointer data)
+static void save_and_quit (void)
 {
+    // the apps which cannot change theme while open might have been started since
+    if (written_config ()->darkmode != cur_conf.darkmode)
+    {
+        if (!system ("pgrep geany > /dev/null"))
+        {
+            message (_("The theme for Geany cannot be changed while it is open.\nPlease close it and try again."), TRUE);
+            return;
+        }
+
+        if (!system ("pgrep galculator > /dev/null"))
+        {
+            message (_("The theme for Calculator cannot be changed while it is open.\nPlease close it and try again."), TRUE);
+            return;
+        }
+    }
+
+    // write out everything staged - the flush reloads the theme if need be
+    flush_changes ();
     update_greeter ();
-    gtk_main_quit ();
+    quit_after_theme ();
+}
+
+static gboolean ok_main (GtkButton *button, gpointer data)
+{
+    save_and_quit ();
     return FALSE;
 }
 
 static gboolean cancel_main (GtkButton *button, gpointer data)
 {
-    if (orig_darkmode != cur_conf.darkmode)
+    if (orig_conf.darkmode != written_config ()->darkmode)
     {
         if (!system ("pgrep geany > /dev/null"))
         {
@@ -629,8 +924,8 @@ static gboolean cancel_main (GtkButton *button, gpointer data)
 
 static gboolean close_prog (GtkWidget *widget, GdkEvent *event, gpointer data)
 {
-    update_greeter ();
-    gtk_main_quit ();
+    // closing the window keeps the changes, as it did when they were written at once
+    save_and_quit ();
     return TRUE;
 }
 
@@ -638,23 +933,44 @@ static gboolean close_prog (GtkWidget *widget, GdkEvent *event, gpointer data)
 /* Main window                                                                */
 /*----------------------------------------------------------------------------*/
 
+static void show_tab (GtkWidget *page, int tab)
+{
+    if (tabs[tab]) return;
+    gtk_box_pack_start (GTK_BOX (page), build_tab (tab), TRUE, TRUE, 0);
+}
+
+static void on_switch_page (GtkNotebook *notebook, GtkWidget *page, guint num, gpointer data)
+{
+    show_tab (page, num);
+}
+
 static gboolean init_window (gpointer data)
 {
     GtkWidget *wid;
+    int page;
 
     init_config ();
 
     // backup current configuration for cancel
     backup_config_files ();
-    orig_darkmode = cur_conf.darkmode;
+    alloc_config (&orig_conf);
+    copy_config (&orig_conf, &cur_conf);
+
+    // changes are previewed in the window and only written out on OK
+    stage_changes (TRUE);
+
+    // tabs are built as they are first shown
+    wid = (GtkWidget *) gtk_builder_get_object (builder, "notebook1");
+    g_signal_connect (wid, "switch-page", G_CALLBACK (on_switch_page), NULL);
 
     // set the initial tab
     if (st_tab)
     {
-        wid = (GtkWidget *) gtk_builder_get_object (builder, "notebook1");
         if (!g_strcmp0 (st_tab, "desktop")) gtk_notebook_set_current_page (GTK_NOTEBOOK (wid), 0);
         if (!g_strcmp0 (st_tab, "taskbar")) gtk_notebook_set_current_page (GTK_NOTEBOOK (wid), 1);
     }
+    page = gtk_notebook_get_current_page (GTK_NOTEBOOK (wid));
+    show_tab (gtk_notebook_get_nth_page (GTK_NOTEBOOK (wid), page), page);
 
     g_object_unref (builder);
 
@@ -690,7 +1006,7 @@ int main (int argc, char *argv[])
     main_dlg = NULL;
     gtk_init (&argc, &argv);
 
-    builder = gtk_builder_new_from_file (PACKAGE_DATA_DIR "/ui/pipanel.ui");
+    builder = gtk_builder_new_from_resource (UI_RESOURCE ("pipanel.ui"));
 
     main_dlg = (GtkWidget *) gtk_builder_get_object (builder, "main_window");
     g_signal_connect (main_dlg, "delete_event", G_CALLBACK (close_prog), NULL);
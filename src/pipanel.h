@@ -36,16 +36,46 @@ extern const char *dgetfixt (const char *domain, const char *msgctxid);
 #define C_(a,b) dgetfixt(GETTEXT_PACKAGE,a"\004"b)
 #endif
 
-#define MAX_DESKTOPS 9
-
 #define TEMP -1
 #define LIGHT 0
 #define DARK  1
 
 #define XC(str) ((xmlChar *) str)
 
+#define GREY    "#808080"
+
 #define SUDO_PREFIX "env SUDO_ASKPASS=/usr/bin/sudopwd sudo -A "
 
+/* UI definitions compiled in as resources */
+#define UI_RESOURCE(f) "/org/raspberrypi/pipanel/ui/" f
+
+/* Fields of the Config which are tracked for changes - see commit.c */
+typedef enum {
+    CONF_DESKTOP,               /* any field of any DesktopConfig */
+    CONF_COMMON_BG,
+    CONF_DESKTOP_FONT,
+    CONF_TERMINAL_FONT,
+    CONF_THEME_COLOUR,
+    CONF_THEMETEXT_COLOUR,
+    CONF_BAR_COLOUR,
+    CONF_BARTEXT_COLOUR,
+    CONF_ICON_SIZE,
+    CONF_TASK_WIDTH,
+    CONF_BARPOS,
+    CONF_MONITOR,
+    CONF_FOLDER_SIZE,
+    CONF_THUMB_SIZE,
+    CONF_PANE_SIZE,
+    CONF_SICON_SIZE,
+    CONF_TB_ICON_SIZE,
+    CONF_LO_ICON_SIZE,
+    CONF_CURSOR_SIZE,
+    CONF_HANDLE_WIDTH,
+    CONF_SCROLLBAR_WIDTH,
+    CONF_DARKMODE,
+    N_CONF_FIELDS
+} ConfigId;
+
 typedef struct {
     const char *desktop_folder;
     const char *desktop_picture;
@@ -55,10 +85,13 @@ typedef struct {
     int show_docs;
     int show_trash;
     int show_mnts;
+    int match_colour;
 } DesktopConfig;
 
+/* The desktops are an array of ndesks, one per monitor, owned by the Config -
+ * so a Config is set up with alloc_config and copied with copy_config */
 typedef struct {
-    DesktopConfig desktops[MAX_DESKTOPS];
+    DesktopConfig *desktops;
     const char *desktop_font;
     const char *terminal_font;
     GdkRGBA theme_colour[2];
@@ -80,8 +113,18 @@ typedef struct {
     int monitor;
     int common_bg;
     int darkmode;
+    unsigned int dirty;         // bits of ConfigId set since the last commit
 } Config;
 
+typedef struct {
+    int index;
+    char *name;
+    int width;
+    int height;
+    char *pcman_file[2];
+    gboolean pcman_exists[2];
+} MonitorInfo;
+
 typedef enum {
     WM_OPENBOX,
     WM_WAYFIRE,
@@ -97,6 +140,7 @@ extern wm_type wm;
 extern int ndesks;
 extern GtkTreeModel *sortmons;
 extern gboolean trix_theme;
+extern MonitorInfo *monitors;
 
 /*----------------------------------------------------------------------------*/
 /* Prototypes                                                                 */
@@ -106,9 +150,21 @@ extern int vsystem (const char *fmt, ...);
 extern char *get_string (char *cmd);
 extern char *get_quoted_string (char *cmd);
 extern char *rgba_to_gdk_color_string (GdkRGBA *col);
+extern const char *conf_string (const char *str);
+extern const char *take_conf_string (char *str);
+extern void alloc_config (Config *conf);
+extern void copy_config (Config *to, const Config *from);
+extern int *map_desktops (const char **names, int old_n);
+extern int remap_monitor (int monitor, const int *map, int old_n);
+extern gboolean *remap_config (Config *conf, const int *map, int old_n);
+extern void free_config (Config *conf);
 extern void check_directory (const char *path);
 extern void message (char *msg, gboolean ok);
 extern const char *theme_name (int dark);
+extern const char *alias_theme_name (int dark);
+extern void update_monitors (void);
+extern const char *monitor_name (int index);
+extern int monitor_index (const char *name);
 
 /* End of file */
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,220 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <gtk/gtk.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
+
+#include "pipanel.h"
+
+#include "registry.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define LO_MISC_PATH "/org.openoffice.Office.Common/Misc"
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static void write_symbolset_item (xmlTextWriterPtr writer, const char *value);
+static gboolean copy_libreoffice_settings (const char *in_file, const char *out_file, const char *value);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static void write_symbolset_item (xmlTextWriterPtr writer, const char *value)
+{
+    xmlTextWriterStartElement (writer, XC ("item"));
+    xmlTextWriterWriteAttribute (writer, XC ("oor:path"), XC (LO_MISC_PATH));
+    xmlTextWriterStartElement (writer, XC ("prop"));
+    xmlTextWriterWriteAttribute (writer, XC ("oor:name"), XC ("SymbolSet"));
+    xmlTextWriterWriteAttribute (writer, XC ("oor:op"), XC ("fuse"));
+    xmlTextWriterWriteElement (writer, XC ("value"), XC (value));
+    xmlTextWriterEndElement (writer);
+    xmlTextWriterEndElement (writer);
+    xmlTextWriterWriteString (writer, XC ("\n"));
+}
+
+static gboolean copy_libreoffice_settings (const char *in_file, const char *out_file, const char *value)
+{
+    xmlTextReaderPtr reader;
+    xmlTextWriterPtr writer;
+    const xmlChar *name;
+    xmlChar *attr;
+    int ret, depth, empty;
+    gboolean in_misc = FALSE, in_symset = FALSE, in_value = FALSE, found = FALSE;
+
+    reader = xmlReaderForFile (in_file, NULL, 0);
+    if (!reader) return FALSE;
+    writer = xmlNewTextWriterFilename (out_file, 0);
+    if (!writer)
+    {
+        xmlFreeTextReader (reader);
+        return FALSE;
+    }
+
+    xmlTextWriterStartDocument (writer, NULL, "UTF-8", NULL);
+    while ((ret = xmlTextReaderRead (reader)) == 1)
+    {
+        depth = xmlTextReaderDepth (reader);
+        switch (xmlTextReaderNodeType (reader))
+        {
+            case XML_READER_TYPE_ELEMENT :
+                name = xmlTextReaderConstName (reader);
+                empty = xmlTextReaderIsEmptyElement (reader);
+
+                // copy the element and its attributes
+                xmlTextWriterStartElement (writer, name);
+                while (xmlTextReaderMoveToNextAttribute (reader) == 1)
+                    xmlTextWriterWriteAttribute (writer, xmlTextReaderConstName (reader), xmlTextReaderConstValue (reader));
+                xmlTextReaderMoveToElement (reader);
+
+                // track whether this is the SymbolSet value in the Misc item
+                if (depth == 1 && !xmlStrcmp (name, XC ("item")))
+                {
+                    attr = xmlTextReaderGetAttribute (reader, XC ("oor:path"));
+                    in_misc = !xmlStrcmp (attr, XC (LO_MISC_PATH));
+                    xmlFree (attr);
+                }
+                else if (depth == 2 && in_misc && !xmlStrcmp (name, XC ("prop")))
+                {
+                    attr = xmlTextReaderGetAttribute (reader, XC ("oor:name"));
+                    in_symset = !xmlStrcmp (attr, XC ("SymbolSet"));
+                    xmlFree (attr);
+                }
+                else if (depth == 3 && in_symset && !xmlStrcmp (name, XC ("value")))
+                {
+                    // replace the content of the value and skip the original
+                    xmlTextWriterWriteString (writer, XC (value));
+                    in_value = !empty;
+                    found = TRUE;
+                }
+
+                if (empty)
+                {
+                    // an empty root element still needs the setting adding
+                    if (depth == 0 && !found)
+                    {
+                        write_symbolset_item (writer, value);
+                        found = TRUE;
+                    }
+                    xmlTextWriterEndElement (writer);
+                }
+                break;
+
+            case XML_READER_TYPE_END_ELEMENT :
+                if (depth == 3) in_value = FALSE;
+                if (depth == 2) in_symset = FALSE;
+                if (depth == 1) in_misc = FALSE;
+
+                // add the setting at the end of the root element if it was not found
+                if (depth == 0 && !found)
+                {
+                    write_symbolset_item (writer, value);
+                    found = TRUE;
+                }
+                xmlTextWriterFullEndElement (writer);
+                break;
+
+            case XML_READER_TYPE_TEXT :
+            case XML_READER_TYPE_WHITESPACE :
+            case XML_READER_TYPE_SIGNIFICANT_WHITESPACE :
+                if (!in_value) xmlTextWriterWriteString (writer, xmlTextReaderConstValue (reader));
+                break;
+
+            case XML_READER_TYPE_CDATA :
+                if (!in_value) xmlTextWriterWriteCDATA (writer, xmlTextReaderConstValue (reader));
+                break;
+
+            case XML_READER_TYPE_COMMENT :
+                xmlTextWriterWriteComment (writer, xmlTextReaderConstValue (reader));
+                break;
+
+            case XML_READER_TYPE_PROCESSING_INSTRUCTION :
+                xmlTextWriterWritePI (writer, xmlTextReaderConstName (reader), xmlTextReaderConstValue (reader));
+                break;
+        }
+    }
+    xmlTextWriterEndDocument (writer);
+
+    xmlFreeTextWriter (writer);
+    xmlFreeTextReader (reader);
+
+    // a read error or a missing root element means the file was not usable
+    return ret == 0 && found;
+}
+
+/*----------------------------------------------------------------------------*/
+/* LibreOffice registry                                                       */
+/*----------------------------------------------------------------------------*/
+
+/* Writes a copy of the LibreOffice registry in in_file to out_file with the
+ * icon size set to value - the file is streamed through a node at a time, as
+ * it grows with every setting LibreOffice remembers. If in_file is missing or
+ * unusable, a new registry holding just this setting is written. Returns FALSE
+ * if out_file could not be written */
+
+gboolean write_libreoffice_settings (const char *in_file, const char *out_file, const char *value)
+{
+    xmlTextWriterPtr writer;
+
+    xmlInitParser ();
+    LIBXML_TEST_VERSION
+
+    // stream the existing file through, changing only the SymbolSet setting
+    if (g_file_test (in_file, G_FILE_TEST_IS_REGULAR) && copy_libreoffice_settings (in_file, out_file, value))
+        return TRUE;
+
+    // no usable file - write a new one containing just the setting
+    writer = xmlNewTextWriterFilename (out_file, 0);
+    if (!writer) return FALSE;
+    xmlTextWriterStartDocument (writer, NULL, "UTF-8", NULL);
+    xmlTextWriterStartElement (writer, XC ("oor:items"));
+    xmlTextWriterWriteAttribute (writer, XC ("xmlns:oor"), XC ("http://openoffice.org/2001/registry"));
+    xmlTextWriterWriteAttribute (writer, XC ("xmlns:xs"), XC ("http://www.w3.org/2001/XMLSchema"));
+    xmlTextWriterWriteAttribute (writer, XC ("xmlns:xsi"), XC ("http://www.w3.org/2001/XMLSchema-instance"));
+    xmlTextWriterWriteString (writer, XC ("\n"));
+    write_symbolset_item (writer, value);
+    xmlTextWriterEndDocument (writer);
+    xmlFreeTextWriter (writer);
+    return TRUE;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,265 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+
+#include "schema.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define CONF(f) offsetof (Config, f)
+#define DESK(f) offsetof (DesktopConfig, f)
+
+#define FIELD(conf,f,type) ((type *) ((char *) (conf) + (f)->offset))
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+static const char * const positions[] = { "top", "bottom", NULL };
+
+/* pcmanfm desktop-items-n.conf - a DesktopConfig. The wallpaper itself and
+ * the desktop font are written by save_pcman_settings, as the first may be a
+ * rendered copy and the second belongs to the Config */
+static const ConfigField pcman_fields[] =
+{
+    { "*", "desktop_bg",        FIELD_COLOUR,   DESK (desktop_colour),      0, 0, 0, NULL, GREY,        0 },
+    { "*", "desktop_shadow",    FIELD_COLOUR,   DESK (desktop_colour),      0, 0, 0, NULL, GREY,        FIELD_SAVE_ONLY },
+    { "*", "desktop_fg",        FIELD_COLOUR,   DESK (desktoptext_colour),  0, 0, 0, NULL, GREY,        0 },
+    { "*", "wallpaper",         FIELD_STRING,   DESK (desktop_picture),     0, 0, 0, NULL, "",          0 },
+    { "*", "wallpaper_source",  FIELD_STRING,   DESK (desktop_picture),     0, 0, 0, NULL, "",          FIELD_SAVE_ONLY },
+    { "*", "wallpaper_mode",    FIELD_STRING,   DESK (desktop_mode),        0, 0, 0, NULL, "color",     0 },
+    { "*", "show_documents",    FIELD_INT,      DESK (show_docs),           0, 1, 0, NULL, "0",         0 },
+    { "*", "show_trash",        FIELD_INT,      DESK (show_trash),          0, 1, 0, NULL, "0",         0 },
+    { "*", "show_mounts",       FIELD_INT,      DESK (show_mnts),           0, 1, 0, NULL, "0",         0 },
+    { "*", "match_colour",      FIELD_INT,      DESK (match_colour),        0, 1, 0, NULL, "0",         0 },
+    { "*", "folder",            FIELD_STRING,   DESK (desktop_folder),      0, 0, 0, NULL, "~/Desktop", 0 }
+};
+
+/* pcmanfm pcmanfm.conf */
+static const ConfigField pcman_g_fields[] =
+{
+    { "ui", "common_bg",        FIELD_INT,      CONF (common_bg),           0, 1, 0, NULL, "0",         0 }
+};
+
+/* wf-panel-pi.ini - the file holds the icon size without its padding */
+static const ConfigField wfpanel_fields[] =
+{
+    { "panel", "position",              FIELD_CHOICE,   CONF (barpos),      0, 0, 0, positions, "0",    0 },
+    { "panel", "icon_size",             FIELD_INT,      CONF (icon_size),   16, 48, 4, NULL, "36",      0 },
+    { "panel", "window-list_max_width", FIELD_INT,      CONF (task_width),  0, 0, 0, NULL, "200",       0 },
+    { "panel", "monitor",               FIELD_MONITOR,  CONF (monitor),     0, 0, 0, NULL, "0",         0 }
+};
+
+/* lxsession desktop.conf - only the plain values, the colour scheme and icon
+ * sizes are compound strings which system.c edits in place */
+static const ConfigField lxsession_fields[] =
+{
+    { "GTK", "sGtk/FontName",           FIELD_STRING,   CONF (desktop_font), 0, 0, 0, NULL, "",         0 },
+    { "GTK", "iGtk/CursorThemeSize",    FIELD_INT,      CONF (cursor_size), 24, 48, 0, NULL, "0",       0 }
+};
+
+const ConfigSchema pcman_schema = { pcman_fields, G_N_ELEMENTS (pcman_fields) };
+const ConfigSchema pcman_g_schema = { pcman_g_fields, G_N_ELEMENTS (pcman_g_fields) };
+const ConfigSchema wfpanel_schema = { wfpanel_fields, G_N_ELEMENTS (wfpanel_fields) };
+const ConfigSchema lxsession_schema = { lxsession_fields, G_N_ELEMENTS (lxsession_fields) };
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static gboolean read_field (const ConfigField *f, GKeyFile *kf, void *conf);
+static void default_field (const ConfigField *f, void *conf, const void *fallback);
+static void write_field (const ConfigField *f, GKeyFile *kf, const void *conf);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+/* Sets a field from its key, if the key is present and its value valid */
+
+static gboolean read_field (const ConfigField *f, GKeyFile *kf, void *conf)
+{
+    GError *err = NULL;
+    GdkRGBA col;
+    char *ret;
+    int val, i;
+
+    if (f->type == FIELD_INT)
+    {
+        val = g_key_file_get_integer (kf, f->group, f->key, &err);
+        if (err)
+        {
+            g_error_free (err);
+            return FALSE;
+        }
+        if (f->min < f->max && (val < f->min || val > f->max)) return FALSE;
+        *FIELD (conf, f, int) = val + f->shift;
+        return TRUE;
+    }
+
+    ret = g_key_file_get_string (kf, f->group, f->key, NULL);
+    if (!ret) return FALSE;
+
+    val = -1;
+    switch (f->type)
+    {
+        case FIELD_STRING :     *FIELD (conf, f, const char *) = take_conf_string (ret);
+                                return TRUE;
+
+        case FIELD_COLOUR :     if (gdk_rgba_parse (&col, ret))
+                                {
+                                    *FIELD (conf, f, GdkRGBA) = col;
+                                    val = 0;
+                                }
+                                break;
+
+        case FIELD_CHOICE :     for (i = 0; f->choices[i]; i++)
+                                    if (!strcmp (ret, f->choices[i])) val = i;
+                                if (val >= 0) *FIELD (conf, f, int) = val;
+                                break;
+
+        case FIELD_MONITOR :    val = monitor_index (ret);
+                                if (val >= 0) *FIELD (conf, f, int) = val;
+                                break;
+
+        default :               break;
+    }
+    g_free (ret);
+
+    return val >= 0;
+}
+
+/* Sets a field from the same field of another structure, or from its default
+ * value if there is none */
+
+static void default_field (const ConfigField *f, void *conf, const void *fallback)
+{
+    switch (f->type)
+    {
+        case FIELD_STRING :     if (fallback) *FIELD (conf, f, const char *) = *FIELD (fallback, f, const char *);
+                                else if (g_str_has_prefix (f->def, "~/"))
+                                    *FIELD (conf, f, const char *) = take_conf_string (g_build_filename (g_get_home_dir (), f->def + 2, NULL));
+                                else *FIELD (conf, f, const char *) = f->def;
+                                break;
+
+        case FIELD_COLOUR :     if (fallback) *FIELD (conf, f, GdkRGBA) = *FIELD (fallback, f, GdkRGBA);
+                                else gdk_rgba_parse (FIELD (conf, f, GdkRGBA), f->def);
+                                break;
+
+        default :               if (fallback) *FIELD (conf, f, int) = *FIELD (fallback, f, int);
+                                else *FIELD (conf, f, int) = atoi (f->def);
+                                break;
+    }
+}
+
+static void write_field (const ConfigField *f, GKeyFile *kf, const void *conf)
+{
+    const char *str;
+    char *col;
+    int val;
+
+    switch (f->type)
+    {
+        case FIELD_INT :        g_key_file_set_integer (kf, f->group, f->key, *FIELD (conf, f, int) - f->shift);
+                                break;
+
+        case FIELD_STRING :     str = *FIELD (conf, f, const char *);
+                                if (str) g_key_file_set_string (kf, f->group, f->key, str);
+                                break;
+
+        case FIELD_COLOUR :     col = rgba_to_gdk_color_string (FIELD (conf, f, GdkRGBA));
+                                g_key_file_set_string (kf, f->group, f->key, col);
+                                g_free (col);
+                                break;
+
+        case FIELD_CHOICE :     val = *FIELD (conf, f, int);
+                                if (val >= 0 && val < g_strv_length ((char **) f->choices))
+                                    g_key_file_set_string (kf, f->group, f->key, f->choices[val]);
+                                break;
+
+        case FIELD_MONITOR :    str = monitor_name (*FIELD (conf, f, int));
+                                if (str) g_key_file_set_string (kf, f->group, f->key, str);
+                                break;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Schema engine                                                              */
+/*----------------------------------------------------------------------------*/
+
+/* Sets every field held in a key file - those whose keys are missing or
+ * invalid are taken from fallback, or from their defaults if it is NULL. A
+ * NULL key file sets every field that way */
+
+void load_fields (const ConfigSchema *schema, GKeyFile *kf, void *conf, const void *fallback)
+{
+    const ConfigField *f;
+
+    for (f = schema->fields; f < schema->fields + schema->n_fields; f++)
+    {
+        if (f->flags & FIELD_SAVE_ONLY) continue;
+        if (!kf || !read_field (f, kf, conf)) default_field (f, conf, fallback);
+    }
+}
+
+/* Sets only the fields whose keys are present and valid, so that a user file
+ * can be laid over the system file it overrides */
+
+void overlay_fields (const ConfigSchema *schema, GKeyFile *kf, void *conf)
+{
+    const ConfigField *f;
+
+    if (!kf) return;
+    for (f = schema->fields; f < schema->fields + schema->n_fields; f++)
+    {
+        if (f->flags & FIELD_SAVE_ONLY) continue;
+        read_field (f, kf, conf);
+    }
+}
+
+void save_fields (const ConfigSchema *schema, GKeyFile *kf, const void *conf)
+{
+    const ConfigField *f;
+
+    for (f = schema->fields; f < schema->fields + schema->n_fields; f++)
+        write_field (f, kf, conf);
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
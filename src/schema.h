@@ -0,0 +1,80 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+typedef enum {
+    FIELD_INT,          /* integer, optionally limited to a range */
+    FIELD_STRING,       /* string */
+    FIELD_COLOUR,       /* GdkRGBA, stored as #RRGGBB */
+    FIELD_CHOICE,       /* integer, stored as the name of its value */
+    FIELD_MONITOR       /* monitor index, stored as the monitor name */
+} FieldType;
+
+/* Field is written but never read - a second key holding the same value */
+#define FIELD_SAVE_ONLY 1
+
+/* Maps one field of a Config or DesktopConfig to a key in a key file */
+typedef struct {
+    const char *group;
+    const char *key;
+    FieldType type;
+    size_t offset;
+    int min;                        /* FIELD_INT - range of values in the file, if min < max */
+    int max;
+    int shift;                      /* FIELD_INT - added to the value read from the file */
+    const char * const *choices;    /* FIELD_CHOICE - names of values 0, 1, ... */
+    const char *def;                /* value when there is neither a key nor another default */
+    int flags;
+} ConfigField;
+
+/* All the fields held in one key file */
+typedef struct {
+    const ConfigField *fields;
+    int n_fields;
+} ConfigSchema;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+extern const ConfigSchema pcman_schema;
+extern const ConfigSchema pcman_g_schema;
+extern const ConfigSchema wfpanel_schema;
+extern const ConfigSchema lxsession_schema;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+extern void load_fields (const ConfigSchema *schema, GKeyFile *kf, void *conf, const void *fallback);
+extern void overlay_fields (const ConfigSchema *schema, GKeyFile *kf, void *conf);
+extern void save_fields (const ConfigSchema *schema, GKeyFile *kf, const void *conf);
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
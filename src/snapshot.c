@@ -0,0 +1,413 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "desktop.h"
+#include "taskbar.h"
+#include "system.h"
+#include "defaults.h"
+#include "files.h"
+#include "wmconf.h"
+
+#include "snapshot.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define SNAPSHOT_VERSION 2
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Key file groups, indexed by snap_group */
+static const char *group_names[SNAP_N_GROUPS] = { "desktop", "taskbar", "session", "wm", "gtk3" };
+
+/* Snapshot as read from disk */
+static GKeyFile *snapshot;
+
+/* Sources of groups which had to be loaded from the files, to be saved with them */
+static char **pending[SNAP_N_GROUPS];
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static char *snapshot_file (void);
+static void add_monitors (GPtrArray *sources);
+static char **group_sources (snap_group group);
+static const char *read_string (const char *group, const char *key, gboolean *ok);
+static void read_colour (const char *group, const char *key, GdkRGBA *colour, gboolean *ok);
+static gboolean read_group (snap_group group);
+static void write_group (snap_group group);
+static void open_snapshot (void);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static char *snapshot_file (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "pipanel", "snapshot.conf", NULL);
+}
+
+static void add_monitors (GPtrArray *sources)
+{
+    int i;
+
+    g_ptr_array_add (sources, g_strdup_printf ("desktops %d", ndesks));
+    for (i = 0; i < ndesks; i++)
+        g_ptr_array_add (sources, g_strdup_printf ("monitor %d %s", i, monitors[i].name ? monitors[i].name : ""));
+}
+
+/* Lists everything the loaders for a group depend on - the stamps of the files
+ * they read, and anything else which changes which files are read or how */
+
+static char **group_sources (snap_group group)
+{
+    GPtrArray *sources = g_ptr_array_new ();
+    char *path, *dir;
+    int dark;
+
+    // values missing from the files are taken from the system defaults
+    add_file_stamp (sources, defaults_cache_file ());
+    g_ptr_array_add (sources, g_strdup_printf ("wm %d", wm));
+
+    switch (group)
+    {
+        case SNAP_DESKTOP :
+            // which desktop file is read depends on the settings and the monitors, so check them all
+            path = pcmanfm_g_file (FALSE);
+            dir = g_path_get_dirname (path);
+            add_dir_stamps (sources, dir, ".conf", NULL);
+            g_free (dir);
+            g_free (path);
+            add_monitors (sources);
+            break;
+
+        case SNAP_TASKBAR :
+            if (wm == WM_OPENBOX) add_file_stamp (sources, lxpanel_file (FALSE));
+            else
+            {
+                add_file_stamp (sources, wfpanel_file (TRUE));
+                add_file_stamp (sources, wfpanel_file (FALSE));
+                add_monitors (sources);
+            }
+            break;
+
+        case SNAP_SESSION :
+            if (wm == WM_OPENBOX) add_file_stamp (sources, lxsession_file (FALSE));
+            else add_file_stamp (sources, dconf_file ());
+            break;
+
+        case SNAP_WM :
+            add_file_stamp (sources, wm_config_file ());
+            break;
+
+        case SNAP_GTK3 :
+            // dark mode comes from the session settings
+            if (wm == WM_OPENBOX) add_file_stamp (sources, lxsession_file (FALSE));
+            else add_file_stamp (sources, dconf_file ());
+
+            // colours come from the user's theme overrides and the system themes
+            for (dark = 0; dark < 2; dark++)
+            {
+                path = g_build_filename (g_get_user_data_dir (), "themes", theme_name (dark), "gtk-3.0", NULL);
+                add_dir_stamps (sources, path, ".css", NULL);
+                g_free (path);
+
+                path = g_build_filename ("/usr/share/themes", theme_name (dark), "gtk-3.0", NULL);
+                add_dir_stamps (sources, path, ".css", "-dark.css");
+                g_free (path);
+            }
+            break;
+
+        default :
+            break;
+    }
+
+    g_ptr_array_add (sources, NULL);
+    return (char **) g_ptr_array_free (sources, FALSE);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Reading and writing groups                                                 */
+/*----------------------------------------------------------------------------*/
+
+static const char *read_string (const char *group, const char *key, gboolean *ok)
+{
+    char *str = g_key_file_get_string (snapshot, group, key, NULL);
+
+    if (!str) *ok = FALSE;
+    return take_conf_string (str);
+}
+
+static void read_colour (const char *group, const char *key, GdkRGBA *colour, gboolean *ok)
+{
+    if (!get_key_colour (snapshot, group, key, colour)) *ok = FALSE;
+}
+
+/* Fills the group's fields of cur_conf from the snapshot - if anything is
+ * missing, FALSE is returned and the loaders overwrite whatever was set */
+
+static gboolean read_group (snap_group group)
+{
+    const char *name = group_names[group];
+    char *dgroup, *key;
+    gboolean ok = TRUE;
+    int i, dark;
+
+    switch (group)
+    {
+        case SNAP_DESKTOP :
+            cur_conf.common_bg = g_key_file_get_integer (snapshot, name, "common_bg", NULL);
+            for (i = 0; i < ndesks; i++)
+            {
+                dgroup = g_strdup_printf ("%s%d", name, i);
+                read_colour (dgroup, "desktop_colour", &cur_conf.desktops[i].desktop_colour, &ok);
+                read_colour (dgroup, "desktoptext_colour", &cur_conf.desktops[i].desktoptext_colour, &ok);
+                cur_conf.desktops[i].desktop_picture = read_string (dgroup, "desktop_picture", &ok);
+                cur_conf.desktops[i].desktop_mode = read_string (dgroup, "desktop_mode", &ok);
+                cur_conf.desktops[i].desktop_folder = read_string (dgroup, "desktop_folder", &ok);
+                cur_conf.desktops[i].show_docs = g_key_file_get_integer (snapshot, dgroup, "show_docs", NULL);
+                cur_conf.desktops[i].show_trash = g_key_file_get_integer (snapshot, dgroup, "show_trash", NULL);
+                cur_conf.desktops[i].show_mnts = g_key_file_get_integer (snapshot, dgroup, "show_mnts", NULL);
+                cur_conf.desktops[i].match_colour = g_key_file_get_integer (snapshot, dgroup, "match_colour", NULL);
+                g_free (dgroup);
+            }
+            break;
+
+        case SNAP_TASKBAR :
+            cur_conf.barpos = g_key_file_get_integer (snapshot, name, "barpos", NULL);
+            cur_conf.icon_size = g_key_file_get_integer (snapshot, name, "icon_size", NULL);
+            cur_conf.task_width = g_key_file_get_integer (snapshot, name, "task_width", NULL);
+            cur_conf.monitor = g_key_file_get_integer (snapshot, name, "monitor", NULL);
+            break;
+
+        case SNAP_SESSION :
+            cur_conf.desktop_font = read_string (name, "desktop_font", &ok);
+            cur_conf.tb_icon_size = g_key_file_get_integer (snapshot, name, "tb_icon_size", NULL);
+            cur_conf.cursor_size = g_key_file_get_integer (snapshot, name, "cursor_size", NULL);
+            break;
+
+        case SNAP_WM :
+            cur_conf.handle_width = g_key_file_get_integer (snapshot, name, "handle_width", NULL);
+            break;
+
+        case SNAP_GTK3 :
+            cur_conf.darkmode = g_key_file_get_integer (snapshot, name, "darkmode", NULL);
+            cur_conf.scrollbar_width = g_key_file_get_integer (snapshot, name, "scrollbar_width", NULL);
+            for (dark = 0; dark < 2; dark++)
+            {
+                key = g_strdup_printf ("theme_colour%d", dark);
+                read_colour (name, key, &cur_conf.theme_colour[dark], &ok);
+                g_free (key);
+                key = g_strdup_printf ("themetext_colour%d", dark);
+                read_colour (name, key, &cur_conf.themetext_colour[dark], &ok);
+                g_free (key);
+                key = g_strdup_printf ("bar_colour%d", dark);
+                read_colour (name, key, &cur_conf.bar_colour[dark], &ok);
+                g_free (key);
+                key = g_strdup_printf ("bartext_colour%d", dark);
+                read_colour (name, key, &cur_conf.bartext_colour[dark], &ok);
+                g_free (key);
+            }
+            break;
+
+        default :
+            break;
+    }
+
+    return ok;
+}
+
+static void write_group (snap_group group)
+{
+    const char *name = group_names[group];
+    char *dgroup, *key;
+    int i, dark;
+
+    g_key_file_set_string_list (snapshot, name, "sources", (const char * const *) pending[group], g_strv_length (pending[group]));
+
+    switch (group)
+    {
+        case SNAP_DESKTOP :
+            g_key_file_set_integer (snapshot, name, "common_bg", cur_conf.common_bg);
+            for (i = 0; i < ndesks; i++)
+            {
+                dgroup = g_strdup_printf ("%s%d", name, i);
+                set_key_colour (snapshot, dgroup, "desktop_colour", &cur_conf.desktops[i].desktop_colour);
+                set_key_colour (snapshot, dgroup, "desktoptext_colour", &cur_conf.desktops[i].desktoptext_colour);
+                g_key_file_set_string (snapshot, dgroup, "desktop_picture", cur_conf.desktops[i].desktop_picture);
+                g_key_file_set_string (snapshot, dgroup, "desktop_mode", cur_conf.desktops[i].desktop_mode);
+                g_key_file_set_string (snapshot, dgroup, "desktop_folder", cur_conf.desktops[i].desktop_folder);
+                g_key_file_set_integer (snapshot, dgroup, "show_docs", cur_conf.desktops[i].show_docs);
+                g_key_file_set_integer (snapshot, dgroup, "show_trash", cur_conf.desktops[i].show_trash);
+                g_key_file_set_integer (snapshot, dgroup, "show_mnts", cur_conf.desktops[i].show_mnts);
+                g_key_file_set_integer (snapshot, dgroup, "match_colour", cur_conf.desktops[i].match_colour);
+                g_free (dgroup);
+            }
+            break;
+
+        case SNAP_TASKBAR :
+            g_key_file_set_integer (snapshot, name, "barpos", cur_conf.barpos);
+            g_key_file_set_integer (snapshot, name, "icon_size", cur_conf.icon_size);
+            g_key_file_set_integer (snapshot, name, "task_width", cur_conf.task_width);
+            g_key_file_set_integer (snapshot, name, "monitor", cur_conf.monitor);
+            break;
+
+        case SNAP_SESSION :
+            g_key_file_set_string (snapshot, name, "desktop_font", cur_conf.desktop_font);
+            g_key_file_set_integer (snapshot, name, "tb_icon_size", cur_conf.tb_icon_size);
+            g_key_file_set_integer (snapshot, name, "cursor_size", cur_conf.cursor_size);
+            break;
+
+        case SNAP_WM :
+            g_key_file_set_integer (snapshot, name, "handle_width", cur_conf.handle_width);
+            break;
+
+        case SNAP_GTK3 :
+            g_key_file_set_integer (snapshot, name, "darkmode", cur_conf.darkmode);
+            g_key_file_set_integer (snapshot, name, "scrollbar_width", cur_conf.scrollbar_width);
+            for (dark = 0; dark < 2; dark++)
+            {
+                key = g_strdup_printf ("theme_colour%d", dark);
+                set_key_colour (snapshot, name, key, &cur_conf.theme_colour[dark]);
+                g_free (key);
+                key = g_strdup_printf ("themetext_colour%d", dark);
+                set_key_colour (snapshot, name, key, &cur_conf.themetext_colour[dark]);
+                g_free (key);
+                key = g_strdup_printf ("bar_colour%d", dark);
+                set_key_colour (snapshot, name, key, &cur_conf.bar_colour[dark]);
+                g_free (key);
+                key = g_strdup_printf ("bartext_colour%d", dark);
+                set_key_colour (snapshot, name, key, &cur_conf.bartext_colour[dark]);
+                g_free (key);
+            }
+            break;
+
+        default :
+            break;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Snapshot                                                                   */
+/*----------------------------------------------------------------------------*/
+
+static void open_snapshot (void)
+{
+    char *path = snapshot_file ();
+
+    snapshot = g_key_file_new ();
+    if (!g_key_file_load_from_file (snapshot, path, G_KEY_FILE_NONE, NULL)
+        || g_key_file_get_integer (snapshot, "snapshot", "version", NULL) != SNAPSHOT_VERSION)
+    {
+        g_key_file_free (snapshot);
+        snapshot = g_key_file_new ();
+    }
+    g_free (path);
+}
+
+/* Fills the fields of cur_conf belonging to a group from the snapshot taken
+ * when they were last loaded, as long as nothing they were loaded from has
+ * changed since. If FALSE is returned, the caller must run the loaders, and
+ * the results are added to the snapshot by save_snapshot. */
+
+gboolean restore_snapshot (snap_group group)
+{
+    char **sources, **cached;
+    gboolean valid = FALSE;
+
+    if (!snapshot) open_snapshot ();
+
+    sources = group_sources (group);
+    cached = g_key_file_get_string_list (snapshot, group_names[group], "sources", NULL, NULL);
+    if (cached && g_strv_equal ((const char * const *) cached, (const char * const *) sources))
+        valid = read_group (group);
+    g_strfreev (cached);
+
+    if (valid) g_strfreev (sources);
+    else
+    {
+        g_strfreev (pending[group]);
+        pending[group] = sources;
+    }
+    return valid;
+}
+
+/* Writes the groups which were loaded from the files back to the snapshot -
+ * called once loading is complete, so nothing is written in the common case
+ * where everything was restored */
+
+void save_snapshot (void)
+{
+    char *path;
+    gboolean changed = FALSE;
+    int group;
+
+    if (!snapshot) return;
+
+    for (group = 0; group < SNAP_N_GROUPS; group++)
+    {
+        if (!pending[group]) continue;
+        write_group (group);
+        g_strfreev (pending[group]);
+        pending[group] = NULL;
+        changed = TRUE;
+    }
+    if (!changed) return;
+
+    g_key_file_set_integer (snapshot, "snapshot", "version", SNAPSHOT_VERSION);
+    path = snapshot_file ();
+    check_directory (path);
+    g_key_file_save_to_file (snapshot, path, NULL);
+    g_free (path);
+}
+
+void free_snapshot (void)
+{
+    int group;
+
+    for (group = 0; group < SNAP_N_GROUPS; group++)
+    {
+        g_strfreev (pending[group]);
+        pending[group] = NULL;
+    }
+    if (snapshot) g_key_file_free (snapshot);
+    snapshot = NULL;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
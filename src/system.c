@@ -28,13 +28,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
 
 #include "pipanel.h"
 #include "taskbar.h"
 #include "desktop.h"
 #include "defaults.h"
+#include "files.h"
+#include "snapshot.h"
+#include "schema.h"
+#include "wmconf.h"
+#include "fontspec.h"
+#include "commit.h"
 
 #include "system.h"
 
@@ -44,6 +48,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define LARGE_ICON_THRESHOLD 20
 
+#define DARK_UNKNOWN -2
+
 /*----------------------------------------------------------------------------*/
 /* Global data                                                                */
 /*----------------------------------------------------------------------------*/
@@ -56,19 +62,28 @@ static GtkWidget *rb_dark, *combo_cursor, *label_cursor;
 static gulong id_cursor, id_dark;
 
 static int orig_csize, orig_tbsize;
-static char *orig_font;
+static const char *orig_font;
+
+/* Dark mode state as returned by is_dark, and the stamp of what it was read from */
+static int dark_state = DARK_UNKNOWN;
+static char *dark_stamp;
 
-/* For Qt5 */
-PangoFontFace *font_face;
+/* Styles showing staged theme settings in this process only */
+static GtkCssProvider *preview_css;
+
+/* Set while a switch back to the real theme is still to come, and whether to
+ * quit once it has been made */
+static guint restore_id;
+static gboolean quit_on_restore;
 
 /*----------------------------------------------------------------------------*/
 /* Prototypes                                                                 */
 /*----------------------------------------------------------------------------*/
 
+static void append_line (const char *file, const char *fmt, ...) G_GNUC_PRINTF (2, 3);
 static void set_config_param (const char *file, const char *section, const char *tag, const char *value);
 static void add_or_amend (const char *conffile, const char *block, const char *param, const char *repl);
-static char *openbox_file (void);
-static char *labwc_file (void);
+static char *dark_mode_stamp (void);
 static void load_obconf_settings (void);
 static void load_lxsession_settings (void);
 static void load_gsettings (void);
@@ -79,10 +94,15 @@ static void save_gsettings (void);
 static void save_xsettings (void);
 static void save_environment (void);
 static void save_labwc_to_settings (void);
+static void make_theme_alias (int dark);
+static void build_theme_alias (const char *alias, const char *sys_dir, int dark);
+static gboolean notify_theme (void);
 static gboolean restore_theme (gpointer data);
 static void on_theme_colour_set (GtkColorChooser *btn, gpointer ptr);
 static void on_theme_textcolour_set (GtkColorChooser *btn, gpointer ptr);
-static void on_theme_font_set (GtkFontChooser *btn, gpointer ptr);
+static void update_font_label (void);
+static void set_chosen_font (GtkFontChooser *chooser);
+static void on_theme_font_clicked (GtkButton *btn, gpointer ptr);
 static void on_theme_dark_set (GtkRadioButton *btn, gpointer ptr);
 static void on_theme_cursor_size_set (GtkComboBox *btn, gpointer ptr);
 
@@ -112,24 +132,41 @@ void restore_gsettings (void)
     }
 }
 
-static void set_config_param (const char *file, const char *section, const char *tag, const char *value)
+/* Adds a line to the end of a file - the file is written afresh rather than
+ * appended to, as the commit journal may hold the original as a link */
+
+static void append_line (const char *file, const char *fmt, ...)
 {
-    char *str;
-    GKeyFile *kf;
+    GString *str;
+    char *old;
     gsize len;
+    va_list arg;
 
-    check_directory (file);
+    str = g_string_new (NULL);
+    if (g_file_get_contents (file, &old, &len, NULL))
+    {
+        g_string_append_len (str, old, len);
+        g_free (old);
+    }
 
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+    va_start (arg, fmt);
+    g_string_append_vprintf (str, fmt, arg);
+    va_end (arg);
+    g_string_append_c (str, '\n');
 
-    g_key_file_set_string (kf, section, tag, value);
+    write_contents (file, str->str, str->len);
+    g_string_free (str, TRUE);
+}
 
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (file, str, len, NULL);
+static void set_config_param (const char *file, const char *section, const char *tag, const char *value)
+{
+    GKeyFile *kf;
 
-    g_free (str);
-    g_key_file_free (kf);
+    check_directory (file);
+
+    kf = load_key_file (file, TRUE);
+    g_key_file_set_string (kf, section, tag, value);
+    save_key_file (file);
 }
 
 static void add_or_amend (const char *conffile, const char *block, const char *param, const char *repl)
@@ -155,7 +192,7 @@ static void add_or_amend (const char *conffile, const char *block, const char *p
     // check the file and block exist - add an empty block if not
     if (!g_file_test (conffile, G_FILE_TEST_IS_REGULAR) || vsystem ("cat %s | tr -d '\\n' | grep -q '%s\\s*{.*}'", conffile, block_ws))
     {
-        vsystem ("echo '\n%s\n{\n}' >> %s", block, conffile);
+        append_line (conffile, "\n%s\n{\n}", block);
     }
 
     // check if the block contains the entry
@@ -181,116 +218,53 @@ char *lxsession_file (gboolean global)
     return g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "lxsession", "rpd-x", "desktop.conf", NULL);
 }
 
-char *xsettings_file (gboolean global)
-{
-    return g_build_filename (global ? "/etc" : g_get_user_config_dir (), "xsettingsd/xsettingsd.conf", NULL);
-}
-
-char *openbox_file (void)
+char *dconf_file (void)
 {
-    return g_build_filename (g_get_user_config_dir (), "openbox", "rpd-rc.xml", NULL);
+    // every gsettings change is written to the user's dconf database
+    return g_build_filename (g_get_user_config_dir (), "dconf", "user", NULL);
 }
 
-static char *labwc_file (void)
+char *xsettings_file (gboolean global)
 {
-    return g_build_filename (g_get_user_config_dir (), "labwc", "rc.xml", NULL);
+    return g_build_filename (global ? "/etc" : g_get_user_config_dir (), "xsettingsd/xsettingsd.conf", NULL);
 }
 
 static void load_obconf_settings (void)
 {
-    char *user_config_file;
+    char *width;
     int val;
-    xmlChar *width;
-
-    xmlDocPtr xDoc;
-    xmlXPathContextPtr xpathCtx;
-    xmlXPathObjectPtr xpathObj;
-    xmlNodePtr node;
 
     DEFAULT (handle_width);
 
-    user_config_file = openbox_file ();
-    if (!g_file_test (user_config_file, G_FILE_TEST_IS_REGULAR))
+    width = get_wm_value (WM_HANDLE_WIDTH);
+    if (width)
     {
-        g_free (user_config_file);
-        return;
-    }
-
-    // read in data from XML file
-    xmlInitParser ();
-    LIBXML_TEST_VERSION
-    xDoc = xmlParseFile (user_config_file);
-    if (xDoc == NULL)
-    {
-        g_free (user_config_file);
-        return;
-    }
-    xpathCtx = xmlXPathNewContext (xDoc);
-
-    xpathObj = xmlXPathEvalExpression ((xmlChar *) "/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='invHandleWidth']", xpathCtx);
-    node = xpathObj->nodesetval->nodeTab[0];
-    if (node)
-    {
-        width = xmlNodeGetContent (node);
-        if (sscanf ((const char *) width, "%d", &val) == 1 && val > 0) cur_conf.handle_width = val;
-        xmlFree (width);
+        if (sscanf (width, "%d", &val) == 1 && val > 0) cur_conf.handle_width = val;
+        g_free (width);
     }
-    xmlXPathFreeObject (xpathObj);
-
-    // cleanup XML
-    xmlXPathFreeContext (xpathCtx);
-    xmlFreeDoc (xDoc);
-    xmlCleanupParser ();
-
-    g_free (user_config_file);
 }
 
 static void load_lxsession_settings (void)
 {
     char *user_config_file, *ret;
     GKeyFile *kf;
-    GError *err;
     int val;
 
     user_config_file = lxsession_file (FALSE);
 
     // read in data from file to a key file structure
-    kf = g_key_file_new ();
-    if (!g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        g_key_file_free (kf);
-        g_free (user_config_file);
-        DEFAULT (desktop_font);
-        DEFAULT (tb_icon_size);
-        DEFAULT (cursor_size);
-        return;
-    }
-
-    // get data from the key file
-    err = NULL;
-    ret = g_key_file_get_string (kf, "GTK", "sGtk/FontName", &err);
-    if (err == NULL) cur_conf.desktop_font = g_strdup (ret);
-    else DEFAULT (desktop_font);
-    g_free (ret);
+    kf = load_key_file (user_config_file, FALSE);
+    load_fields (&lxsession_schema, kf, &cur_conf, &def_med);
 
-    err = NULL;
-    ret = g_key_file_get_string (kf, "GTK", "sGtk/IconSizes", &err);
+    // the toolbar icon size is one element of a compound string
     DEFAULT (tb_icon_size);
-    if (err == NULL)
+    ret = kf ? g_key_file_get_string (kf, "GTK", "sGtk/IconSizes", NULL) : NULL;
+    if (ret && sscanf (ret, "gtk-large-toolbar=%d,", &val) == 1)
     {
-        if (sscanf (ret, "gtk-large-toolbar=%d,", &val) == 1)
-        {
-            if (val >= 8 && val <= 256) cur_conf.tb_icon_size = val;
-        }
+        if (val >= 8 && val <= 256) cur_conf.tb_icon_size = val;
     }
     g_free (ret);
 
-    err = NULL;
-    val = g_key_file_get_integer (kf, "GTK", "iGtk/CursorThemeSize", &err);
-    if (err == NULL && val >= 24 && val <= 48) cur_conf.cursor_size = val;
-    else DEFAULT (cursor_size);
-
-    g_key_file_free (kf);
     g_free (user_config_file);
 }
 
@@ -301,7 +275,7 @@ static void load_gsettings (void)
 
     res = get_quoted_string ("gsettings get org.gnome.desktop.interface font-name");
     if (!res[0]) DEFAULT (desktop_font);
-    else cur_conf.desktop_font = g_strdup (res);
+    else cur_conf.desktop_font = conf_string (res);
     g_free (res);
 
     res = get_string ("gsettings get org.gnome.desktop.interface cursor-size");
@@ -396,239 +370,54 @@ static void load_gtk3_settings (void)
 
 static void save_wm_settings (void)
 {
-    char *user_config_file, *cptr;
-    int count, size;
-    const gchar *font = NULL, *weight = NULL, *style = NULL;
+    const FontSpec *fs;
+    char *cptr;
     char buf[10];
 
-    xmlDocPtr xDoc;
-    xmlXPathContextPtr xpathCtx;
-    xmlXPathObjectPtr xpathObj;
-    xmlNodePtr root, cur_node, node;
-
-    if (wm == WM_LABWC) user_config_file = labwc_file ();
-    else if (wm == WM_OPENBOX) user_config_file = openbox_file ();
-    else return;
-
-    check_directory (user_config_file);
-
-    // set the font description variables for XML from the font name
-    PangoFontDescription *pfd = pango_font_description_from_string (cur_conf.desktop_font);
-    font = pango_font_description_get_family (pfd);
-    size = pango_font_description_get_size (pfd) / (pango_font_description_get_size_is_absolute (pfd) ? 1 : PANGO_SCALE);
-    sprintf (buf, "%d", size);
-    PangoWeight pweight = pango_font_description_get_weight (pfd);
-    PangoStyle pstyle = pango_font_description_get_style (pfd);
-
-    if (wm == WM_OPENBOX)
-    {
-        // openbox only recognises bold and italic - anything else is ignored
-        if (pweight == PANGO_WEIGHT_BOLD) weight = "Bold";
-        else weight = "Normal";
-
-        if (pstyle == PANGO_STYLE_ITALIC) style = "Italic";
-        else style = "Normal";
-    }
-    else
-    {
-        // labwc (now) recognises all weights and styles
-        switch (pweight)
-        {
-            case PANGO_WEIGHT_THIN :        weight = "Thin";
-                                            break;
-            case PANGO_WEIGHT_ULTRALIGHT :  weight = "Ultralight";
-                                            break;
-            case PANGO_WEIGHT_LIGHT :       weight = "Light";
-                                            break;
-            case PANGO_WEIGHT_SEMILIGHT :   weight = "Semilight";
-                                            break;
-            case PANGO_WEIGHT_BOOK :        weight = "Book";
-                                            break;
-            case PANGO_WEIGHT_NORMAL :      weight = "Normal";
-                                            break;
-            case PANGO_WEIGHT_MEDIUM :      weight = "Medium";
-                                            break;
-            case PANGO_WEIGHT_SEMIBOLD :    weight = "Semibold";
-                                            break;
-            case PANGO_WEIGHT_BOLD :        weight = "Bold";
-                                            break;
-            case PANGO_WEIGHT_ULTRABOLD :   weight = "Ultrabold";
-                                            break;
-            case PANGO_WEIGHT_HEAVY :       weight = "Heavy";
-                                            break;
-            case PANGO_WEIGHT_ULTRAHEAVY :  weight = "Ultraheavy";
-                                            break;
-        }
-
-        switch (pstyle)
-        {
-            case PANGO_STYLE_NORMAL :       style = "Normal";
-                                            break;
-            case PANGO_STYLE_ITALIC :       style = "Italic";
-                                            break;
-            case PANGO_STYLE_OBLIQUE :      style = "Oblique";
-                                            break;
-        }
-    }
-
-    // read in data from XML file
-    xmlInitParser ();
-    LIBXML_TEST_VERSION
-    if (g_file_test (user_config_file, G_FILE_TEST_IS_REGULAR))
-    {
-        xDoc = xmlParseFile (user_config_file);
-        if (!xDoc) xDoc = xmlNewDoc ((xmlChar *) "1.0");
-    }
-    else xDoc = xmlNewDoc ((xmlChar *) "1.0");
-    xpathCtx = xmlXPathNewContext (xDoc);
-
-    // check that the config and theme nodes exist in the document - create them if not
-    xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']"), xpathCtx);
-    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-    {
-        root = xmlNewNode (NULL, XC ("openbox_config"));
-        xmlDocSetRootElement (xDoc, root);
-        xmlNewNs (root, XC ("http://openbox.org/3.4/rc"), NULL);
-        xmlXPathRegisterNs (xpathCtx, XC ("openbox_config"), XC ("http://openbox.org/3.4/rc"));
-    }
-    else root = xpathObj->nodesetval->nodeTab[0];
-    xmlXPathFreeObject (xpathObj);
-
-    xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval)) xmlNewChild (root, NULL, XC ("theme"), NULL);
-    xmlXPathFreeObject (xpathObj);
+    if (wm == WM_WAYFIRE) return;
 
-    // update relevant nodes with new values
-    xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='font']"), xpathCtx);
-    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-    {
-        xmlXPathFreeObject (xpathObj);
-        xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-        for (count = 0; count < 2; count ++)
-        {
-            cur_node = xmlNewChild (xpathObj->nodesetval->nodeTab[0], NULL, XC ("font"), NULL);
-
-            xmlSetProp (cur_node, XC ("place"), count == 0 ? XC ("ActiveWindow") : XC ("InactiveWindow"));
-            xmlNewChild (cur_node, NULL, XC ("name"), XC (font));
-            xmlNewChild (cur_node, NULL, XC ("size"), XC (buf));
-            xmlNewChild (cur_node, NULL, XC ("weight"), XC (weight));
-            xmlNewChild (cur_node, NULL, XC ("slant"), XC (style));
-        }
-    }
-    else
-    {
-        for (count = 0; count < xpathObj->nodesetval->nodeNr; count++)
-        {
-            node = xpathObj->nodesetval->nodeTab[count];
-            for (cur_node = node->children; cur_node; cur_node = cur_node->next)
-            {
-                if (cur_node->type == XML_ELEMENT_NODE)
-                {
-                    if (!xmlStrcmp (cur_node->name, XC ("name"))) xmlNodeSetContent (cur_node, XC (font));
-                    if (!xmlStrcmp (cur_node->name, XC ("size"))) xmlNodeSetContent (cur_node, XC (buf));
-                    if (!xmlStrcmp (cur_node->name, XC ("weight"))) xmlNodeSetContent (cur_node, XC (weight));
-                    if (!xmlStrcmp (cur_node->name, XC ("slant")))  xmlNodeSetContent (cur_node, XC (style));
-                }
-            }
-        }
-    }
-    xmlXPathFreeObject (xpathObj);
-    pango_font_description_free (pfd);
+    // update font nodes with new values - openbox only recognises bold and italic, labwc (now) recognises all weights and styles
+    fs = font_spec (cur_conf.desktop_font);
+    if (wm == WM_OPENBOX) set_wm_font (fs->family, fs->size_str, fs->openbox_weight, fs->openbox_style);
+    else set_wm_font (fs->family, fs->size_str, fs->labwc_weight, fs->labwc_style);
 
     cptr = g_strdup_printf ("%s%s", theme_name (cur_conf.darkmode), cur_conf.scrollbar_width >= 17 ? "_l" : "");
-    xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='name']"), xpathCtx);
-    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-    {
-        xmlXPathFreeObject (xpathObj);
-        xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-        cur_node = xpathObj->nodesetval->nodeTab[0];
-        xmlNewChild (cur_node, NULL, XC ("name"), XC (cptr));
-    }
-    else
-    {
-        cur_node = xpathObj->nodesetval->nodeTab[0];
-        xmlNodeSetContent (cur_node, XC (cptr));
-    }
+    set_wm_value (WM_THEME_NAME, cptr);
     g_free (cptr);
 
     if (wm == WM_LABWC) save_labwc_to_settings ();
     else
     {
         sprintf (buf, "%d", cur_conf.handle_width);
-        xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='invHandleWidth']"), xpathCtx);
-        if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-        {
-            xmlXPathFreeObject (xpathObj);
-            xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNewChild (cur_node, NULL, XC ("invHandleWidth"), XC (buf));
-        }
-        else
-        {
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNodeSetContent (cur_node, XC (buf));
-        }
-        xmlXPathFreeObject (xpathObj);
+        set_wm_value (WM_HANDLE_WIDTH, buf);
 
         cptr = rgba_to_gdk_color_string (&cur_conf.theme_colour[cur_conf.darkmode]);
-        xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='titleColor']"), xpathCtx);
-        if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-        {
-            xmlXPathFreeObject (xpathObj);
-            xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNewChild (cur_node, NULL, XC ("titleColor"), XC (cptr));
-        }
-        else
-        {
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNodeSetContent (cur_node, XC (cptr));
-        }
-        xmlXPathFreeObject (xpathObj);
+        set_wm_value (WM_TITLE_COLOUR, cptr);
         g_free (cptr);
 
         cptr = rgba_to_gdk_color_string (&cur_conf.themetext_colour[cur_conf.darkmode]);
-        xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']/*[local-name()='textColor']"), xpathCtx);
-        if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
-        {
-            xmlXPathFreeObject (xpathObj);
-            xpathObj = xmlXPathEvalExpression (XC ("/*[local-name()='openbox_config']/*[local-name()='theme']"), xpathCtx);
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNewChild (cur_node, NULL, XC ("textColor"), XC (cptr));
-        }
-        else
-        {
-            cur_node = xpathObj->nodesetval->nodeTab[0];
-            xmlNodeSetContent (cur_node, XC (cptr));
-        }
-        xmlXPathFreeObject (xpathObj);
+        set_wm_value (WM_TEXT_COLOUR, cptr);
         g_free (cptr);
     }
 
-    // cleanup XML
-    xmlXPathFreeContext (xpathCtx);
-    xmlSaveFile (user_config_file, xDoc);
-    xmlFreeDoc (xDoc);
-    xmlCleanupParser ();
-
-    g_free (user_config_file);
+    // write the file if anything has changed
+    save_wm_config ();
 }
 
 static void save_lxsession_settings (void)
 {
     char *user_config_file, *str, *ostr, *ctheme, *cthemet, *cbar, *cbart;
     GKeyFile *kf;
-    gsize len;
     GError *err;
 
     user_config_file = lxsession_file (FALSE);
     check_directory (user_config_file);
 
     // read in data from file to a key file
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+    kf = load_key_file (user_config_file, TRUE);
 
-    g_key_file_set_string (kf, "GTK", "sNet/ThemeName", theme_name (TEMP));
+    // always the real theme, never the alias used to reload it
+    g_key_file_set_string (kf, "GTK", "sNet/ThemeName", theme_name (cur_conf.darkmode));
 
     // update changed values in the key file
     ctheme = rgba_to_gdk_color_string (&cur_conf.theme_colour[cur_conf.darkmode]);
@@ -645,7 +434,7 @@ static void save_lxsession_settings (void)
     g_free (cbart);
     g_free (str);
 
-    g_key_file_set_string (kf, "GTK", "sGtk/FontName", cur_conf.desktop_font);
+    save_fields (&lxsession_schema, kf, &cur_conf);
     int tbi = GTK_ICON_SIZE_LARGE_TOOLBAR;
     if (cur_conf.tb_icon_size == 16) tbi = GTK_ICON_SIZE_SMALL_TOOLBAR;
     if (cur_conf.tb_icon_size == 48) tbi = GTK_ICON_SIZE_DIALOG;
@@ -686,14 +475,8 @@ static void save_lxsession_settings (void)
     g_free (ostr);
     g_free (str);
 
-    g_key_file_set_integer (kf, "GTK", "iGtk/CursorThemeSize", cur_conf.cursor_size);
-
     // write the modified key file out
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
-
-    g_free (str);
-    g_key_file_free (kf);
+    save_key_file (user_config_file);
     g_free (user_config_file);
 }
 
@@ -714,7 +497,7 @@ static void save_gsettings (void)
 
 void save_gtk3_settings (void)
 {
-    char *user_config_file, *cstrb, *cstrf, *cstrbb, *cstrbf, *link1, *link2, *repl;
+    char *user_config_file, *cstrb, *cstrf, *cstrbb, *cstrbf, *repl;
     int dark;
 
     // delete old file used to store general overrides
@@ -722,15 +505,8 @@ void save_gtk3_settings (void)
     vsystem ("if grep -q -s define-color %s ; then rm %s ; fi", user_config_file, user_config_file);
     g_free (user_config_file);
 
-    // create a temp theme to switch to
-    link1 = g_build_filename (g_get_user_data_dir (), "themes", theme_name (TEMP), NULL);
-    if (!g_file_test (link1, G_FILE_TEST_IS_DIR))
-    {
-        link2 = g_build_filename (g_get_user_data_dir (), "themes", theme_name (is_dark () == 1), NULL);
-        symlink (link2, link1);
-        g_free (link2);
-    }
-    g_free (link1);
+    // create the alias themes to switch to, if they are missing or stale
+    for (dark = 0; dark < 2; dark++) make_theme_alias (dark);
 
     for (dark = 0; dark < 2; dark++)
     {
@@ -763,22 +539,22 @@ void save_gtk3_settings (void)
 
         // amend entries already in file, or add if not present
         if (vsystem ("grep -q theme_selected_bg_color %s\n", user_config_file))
-            vsystem ("echo '@define-color theme_selected_bg_color %s;' >> %s", cstrb, user_config_file);
+            append_line (user_config_file, "@define-color theme_selected_bg_color %s;", cstrb);
         else
             vsystem ("sed -i s/'theme_selected_bg_color #......'/'theme_selected_bg_color %s'/g %s", cstrb, user_config_file);
 
         if (vsystem ("grep -q theme_selected_fg_color %s\n", user_config_file))
-            vsystem ("echo '@define-color theme_selected_fg_color %s;' >> %s", cstrf, user_config_file);
+            append_line (user_config_file, "@define-color theme_selected_fg_color %s;", cstrf);
         else
             vsystem ("sed -i s/'theme_selected_fg_color #......'/'theme_selected_fg_color %s'/g %s", cstrf, user_config_file);
 
         if (vsystem ("grep -q bar_bg_color %s\n", user_config_file))
-            vsystem ("echo '@define-color bar_bg_color %s;' >> %s", cstrbb, user_config_file);
+            append_line (user_config_file, "@define-color bar_bg_color %s;", cstrbb);
         else
             vsystem ("sed -i s/'bar_bg_color #......'/'bar_bg_color %s'/g %s", cstrbb, user_config_file);
 
         if (vsystem ("grep -q bar_fg_color %s\n", user_config_file))
-            vsystem ("echo '@define-color bar_fg_color %s;' >> %s", cstrbf, user_config_file);
+            append_line (user_config_file, "@define-color bar_fg_color %s;", cstrbf);
         else
             vsystem ("sed -i s/'bar_fg_color #......'/'bar_fg_color %s'/g %s", cstrbf, user_config_file);
 
@@ -879,7 +655,7 @@ static void save_environment (void)
 
     // amend entry already in file, or add if not present
     if (vsystem ("grep -q XCURSOR_SIZE %s\n", user_config_file))
-        vsystem ("echo 'XCURSOR_SIZE=%d' >> %s", cur_conf.cursor_size, user_config_file);
+        append_line (user_config_file, "XCURSOR_SIZE=%d", cur_conf.cursor_size);
     else
         vsystem ("sed -i s/'XCURSOR_SIZE.*'/'XCURSOR_SIZE=%d'/g %s", cur_conf.cursor_size, user_config_file);
 
@@ -888,7 +664,6 @@ static void save_environment (void)
 
 void save_session_settings (void)
 {
-    set_theme (theme_name (TEMP));
     if (wm == WM_OPENBOX) save_lxsession_settings ();
     else 
     {
@@ -901,7 +676,7 @@ void save_session_settings (void)
 
 #define LABWC_THEME_UPDATE(param,value) \
     if (vsystem ("grep -q %s %s\n", param, user_config_file)) \
-        vsystem ("echo '%s: %s' >> %s", param, value, user_config_file); \
+        append_line (user_config_file, "%s: %s", param, value); \
     else \
         vsystem ("sed -i s/'%s.*'/'%s: %s'/g %s", param, param, value, user_config_file);
 
@@ -952,7 +727,7 @@ void save_greeter_settings (void)
     g_key_file_set_value (kf, "greeter", "gtk-font-name", cur_conf.desktop_font);
 
     str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (GREETER_TMP, str, len, NULL);
+    write_contents (GREETER_TMP, str, len);
 
     g_free (str);
     g_key_file_free (kf);
@@ -960,57 +735,15 @@ void save_greeter_settings (void)
 
 void save_qt_settings (void)
 {
-    char *user_config_file, *str, *cstrb, *cstrf;
+    char *user_config_file, *str, *cstrb, *cstrf, *src, *dst, *data;
+    const char *name;
     GKeyFile *kf;
+    const FontSpec *fs;
+    GDir *dir;
     gsize len;
-    char *bufqt5, *bufqt6;
-    const char *font;
-    int size, weight, style, index, dark;
-
-    // parse the font description
-    PangoFontDescription *pfd = pango_font_description_from_string (cur_conf.desktop_font);
-    font = pango_font_description_get_family (pfd);
-    size = pango_font_description_get_size (pfd) / (pango_font_description_get_size_is_absolute (pfd) ? 1 : PANGO_SCALE);
-    PangoWeight pweight = pango_font_description_get_weight (pfd);
-    PangoStyle pstyle = pango_font_description_get_style (pfd);
-
-    switch (pweight)
-    {
-        case PANGO_WEIGHT_THIN :        weight = 0;
-                                        break;
-        case PANGO_WEIGHT_ULTRALIGHT :  weight = 12;
-                                        break;
-        case PANGO_WEIGHT_LIGHT :       weight = 25;
-                                        break;
-        case PANGO_WEIGHT_MEDIUM :      weight = 57;
-                                        break;
-        case PANGO_WEIGHT_SEMIBOLD :    weight = 63;
-                                        break;
-        case PANGO_WEIGHT_BOLD :        weight = 75;
-                                        break;
-        case PANGO_WEIGHT_ULTRABOLD :   weight = 81;
-                                        break;
-        case PANGO_WEIGHT_HEAVY :
-        case PANGO_WEIGHT_ULTRAHEAVY :  weight = 87;
-                                        break;
-        default :                       weight = 50;
-                                        break;
-    }
-
-    switch (pstyle)
-    {
-        case PANGO_STYLE_ITALIC :   style = 1;
-                                    break;
-        case PANGO_STYLE_OBLIQUE :  style = 2;
-                                    break;
-        default :                   style = 0;
-                                    break;
-    }
+    int index, dark;
 
-    bufqt5 = g_strdup_printf ("\"%s,%d,-1,5,%d,0,0,0,0,0,%s\"", font, size, weight, pango_font_face_get_face_name (font_face));
-    bufqt6 = g_strdup_printf ("\"%s,%d,-1,5,%d,%d,0,0,0,0,0,0,0,0,0,1\"", font, size, pweight, style);
-
-    pango_font_description_free (pfd);
+    fs = font_spec (cur_conf.desktop_font);
 
     // write files for Qt5 (index = 0) and Qt6 (1)
     for (index = 0; index < 2; index++)
@@ -1022,18 +755,37 @@ void save_qt_settings (void)
         {
             str = g_build_filename (g_get_user_config_dir (), "qt6ct/colors/", NULL);
             g_mkdir_with_parents (str, S_IRUSR | S_IWUSR | S_IXUSR);
-            vsystem ("cp /etc/xdg/qt6ct/colors/* %s/qt6ct/colors/", g_get_user_config_dir ());
+
+            // the colour schemes are replaced by rename rather than copied over, so
+            // the journal's links to the old files keep their contents
+            dir = g_dir_open ("/etc/xdg/qt6ct/colors", 0, NULL);
+            if (dir)
+            {
+                while ((name = g_dir_read_name (dir)))
+                {
+                    src = g_build_filename ("/etc/xdg/qt6ct/colors", name, NULL);
+                    if (g_file_get_contents (src, &data, &len, NULL))
+                    {
+                        dst = g_build_filename (str, name, NULL);
+                        write_contents (dst, data, len);
+                        g_free (dst);
+                        g_free (data);
+                    }
+                    g_free (src);
+                }
+                g_dir_close (dir);
+            }
             g_free (str);
         }
 
-        // read in data from file to a key file - read system defaults first for Qt6, as they aren't inherited...
-        kf = g_key_file_new ();
-        if (index) g_key_file_load_from_file (kf, "/etc/xdg/qt6ct/qt6ct.conf", G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
-        g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
+        // read in data from file to a key file - start from system defaults for Qt6, as they aren't inherited...
+        kf = load_key_file (user_config_file, TRUE);
+        if (index && !g_file_test (user_config_file, G_FILE_TEST_IS_REGULAR))
+            g_key_file_load_from_file (kf, "/etc/xdg/qt6ct/qt6ct.conf", G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
 
         // update changed values in the key file
-        g_key_file_set_value (kf, "Fonts", "fixed", index ? bufqt6 : bufqt5);
-        g_key_file_set_value (kf, "Fonts", "general", index ? bufqt6 : bufqt5);
+        g_key_file_set_value (kf, "Fonts", "fixed", index ? fs->qt6 : fs->qt5);
+        g_key_file_set_value (kf, "Fonts", "general", index ? fs->qt6 : fs->qt5);
 
         if (index)
         {
@@ -1058,20 +810,15 @@ void save_qt_settings (void)
         }
 
         // write the modified key file out
-        str = g_key_file_to_data (kf, &len, NULL);
-        g_file_set_contents (user_config_file, str, len, NULL);
+        save_key_file (user_config_file);
         g_free (user_config_file);
-
-        g_free (str);
-        g_key_file_free (kf);
     }
-    g_free (bufqt5);
-    g_free (bufqt6);
 }
 
 void save_app_settings (void)
 {
     char *config_file;
+    GKeyFile *kf;
 
     // geany colour theme
     config_file = g_build_filename (g_get_user_config_dir (), "geany/geany.conf", NULL);
@@ -1080,9 +827,12 @@ void save_app_settings (void)
 
     // galculator display colours
     config_file = g_build_filename (g_get_user_config_dir (), "galculator/galculator.conf", NULL);
-    set_config_param (config_file, "general", "display_bkg_color", cur_conf.darkmode ? "rgb(94,92,100)" : "#ffffff");
-    set_config_param (config_file, "general", "display_result_color", cur_conf.darkmode ? "rgb(246,245,244)" : "black");
-    set_config_param (config_file, "general", "display_stack_color", cur_conf.darkmode ? "rgb(246,245,244)" : "black");
+    check_directory (config_file);
+    kf = load_key_file (config_file, TRUE);
+    g_key_file_set_string (kf, "general", "display_bkg_color", cur_conf.darkmode ? "rgb(94,92,100)" : "#ffffff");
+    g_key_file_set_string (kf, "general", "display_result_color", cur_conf.darkmode ? "rgb(246,245,244)" : "black");
+    g_key_file_set_string (kf, "general", "display_stack_color", cur_conf.darkmode ? "rgb(246,245,244)" : "black");
+    save_key_file (config_file);
     g_free (config_file);
 }
 
@@ -1110,39 +860,265 @@ void set_theme (const char *theme)
         g_free (user_config_file);
         reload_session ();
     }
+
+    // the new theme is known, so there is no need to read it back
+    if (dark_state >= 0)
+    {
+        dark_state = strstr (theme, theme_name (DARK)) ? 1 : 0;
+        g_free (dark_stamp);
+        dark_stamp = dark_mode_stamp ();
+    }
+}
+
+/* Identifies the state of everything is_dark reads - if this changes, the
+ * theme may have been changed externally */
+
+static char *dark_mode_stamp (void)
+{
+    char *path, *theme, *session, *res;
+
+    path = g_build_filename ("/usr/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
+    theme = file_stamp (path);
+    g_free (path);
+
+    path = (wm == WM_OPENBOX) ? lxsession_file (FALSE) : dconf_file ();
+    session = file_stamp (path);
+    g_free (path);
+
+    res = g_strdup_printf ("%s %s", theme, session);
+    g_free (session);
+    g_free (theme);
+    return res;
 }
 
+/* Returns -1 if the dark theme is not installed, otherwise 1 if it is in use
+ * and 0 if not. The result is remembered, and only read again if the session
+ * settings have been changed by something other than set_theme. */
+
 int is_dark (void)
 {
+    char *stamp, *config_file;
     int res;
 
-    char *config_file = g_build_filename ("/usr/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
-    if (access (config_file, F_OK)) return -1;
+    stamp = dark_mode_stamp ();
+    if (dark_state != DARK_UNKNOWN && !g_strcmp0 (stamp, dark_stamp))
+    {
+        g_free (stamp);
+        return dark_state;
+    }
+
+    config_file = g_build_filename ("/usr/share/themes", theme_name (DARK), "gtk-3.0/gtk.css", NULL);
+    if (access (config_file, F_OK)) res = -1;
+    else if (wm == WM_OPENBOX)
+    {
+        char *user_config_file = lxsession_file (FALSE);
+        res = vsystem ("grep sNet/ThemeName %s | grep -q %s", user_config_file, theme_name (DARK)) ? 0 : 1;
+        g_free (user_config_file);
+    }
+    else res = vsystem ("gsettings get org.gnome.desktop.interface gtk-theme | grep -q %s", theme_name (DARK)) ? 0 : 1;
     g_free (config_file);
 
+    g_free (dark_stamp);
+    dark_stamp = stamp;
+    dark_state = res;
+    return res;
+}
+
+void invalidate_dark_mode (void)
+{
+    dark_state = DARK_UNKNOWN;
+}
+
+char *get_theme (void)
+{
+    char *user_config_file, *res = NULL;
+    GKeyFile *kf;
+
     if (wm == WM_OPENBOX)
     {
-        char *user_config_file = lxsession_file (FALSE);
-        res = vsystem ("grep sNet/ThemeName %s | grep -q %s", user_config_file, theme_name (DARK));
+        user_config_file = lxsession_file (FALSE);
+        kf = load_key_file (user_config_file, FALSE);
+        if (kf) res = g_key_file_get_string (kf, "GTK", "sNet/ThemeName", NULL);
+        g_free (user_config_file);
+        return res;
+    }
+    else return get_quoted_string ("gsettings get org.gnome.desktop.interface gtk-theme");
+}
+
+static void make_theme_alias (int dark)
+{
+    char *alias, *sys_dir, *stamp, *stamp_file, *old_stamp = NULL;
+
+    /* The system theme directory's stamp is kept with the alias, so the alias
+     * is only made again when that theme changes */
+    alias = g_build_filename (g_get_user_data_dir (), "themes", alias_theme_name (dark), NULL);
+    sys_dir = g_build_filename ("/usr/share/themes", theme_name (dark), NULL);
+    stamp_file = g_build_filename (alias, ".stamp", NULL);
+    stamp = file_stamp (sys_dir);
+
+    g_file_get_contents (stamp_file, &old_stamp, NULL, NULL);
+    if (g_strcmp0 (old_stamp, stamp))
+    {
+        build_theme_alias (alias, sys_dir, dark);
+        g_file_set_contents (stamp_file, stamp, -1, NULL);
+    }
+
+    g_free (old_stamp);
+    g_free (stamp);
+    g_free (stamp_file);
+    g_free (sys_dir);
+    g_free (alias);
+}
+
+static void build_theme_alias (const char *alias, const char *sys_dir, int dark)
+{
+    char *link, *target;
+    const char *name;
+    GDir *dir;
+
+    /* The alias is a copy of the theme made of symlinks - the GTK3 directory
+     * points at the user theme, so it picks up the user CSS, and everything
+     * else points at the system theme */
+
+    // older versions made the alias a single link to the user theme
+    if (g_file_test (alias, G_FILE_TEST_IS_SYMLINK)) g_remove (alias);
+    g_mkdir_with_parents (alias, S_IRUSR | S_IWUSR | S_IXUSR);
+
+    dir = g_dir_open (alias, 0, NULL);
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)))
+        {
+            link = g_build_filename (alias, name, NULL);
+            if (g_file_test (link, G_FILE_TEST_IS_SYMLINK)) g_remove (link);
+            g_free (link);
+        }
+        g_dir_close (dir);
+    }
+
+    link = g_build_filename (alias, "gtk-3.0", NULL);
+    target = g_build_filename (g_get_user_data_dir (), "themes", theme_name (dark), "gtk-3.0", NULL);
+    symlink (target, link);
+    g_free (target);
+    g_free (link);
+
+    dir = g_dir_open (sys_dir, 0, NULL);
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)))
+        {
+            if (!g_strcmp0 (name, "gtk-3.0")) continue;
+            link = g_build_filename (alias, name, NULL);
+            target = g_build_filename (sys_dir, name, NULL);
+            symlink (target, link);
+            g_free (target);
+            g_free (link);
+        }
+        g_dir_close (dir);
+    }
+}
+
+/* Makes running GTK apps restyle once without a change of theme name - FALSE
+ * if nothing is there to tell them */
+static gboolean notify_theme (void)
+{
+    char *user_config_file;
+
+    if (wm == WM_OPENBOX)
+    {
+        // lxsession watches its data file and sends its settings out again, with a new serial, when it changes
+        if (vsystem ("pgrep -x lxsession > /dev/null")) return FALSE;
+        user_config_file = lxsession_file (FALSE);
+        g_utime (user_config_file, NULL);
         g_free (user_config_file);
+        return TRUE;
     }
-    else res = vsystem ("gsettings get org.gnome.desktop.interface gtk-theme | grep -q %s", theme_name (DARK));
 
-    if (!res) return 1;
-    else return 0;
+    // setting the same name still signals GSettings listeners, and a HUP makes xsettingsd send again with a new serial
+    if (vsystem ("gsettings set org.gnome.desktop.interface gtk-theme %s", theme_name (cur_conf.darkmode))) return FALSE;
+    vsystem ("pgrep xsettingsd > /dev/null && killall -HUP xsettingsd");
+    return TRUE;
+}
+
+void refresh_theme (void)
+{
+    const char *theme = theme_name (cur_conf.darkmode);
+    char *cur = get_theme ();
+
+    /* A change of name restyles apps by itself; if the name is unchanged they
+     * are told once. Only if that cannot be done is the alias, which shares the
+     * user CSS, switched to and the real theme put back afterwards */
+    if (g_strcmp0 (cur, theme)) set_theme (theme);
+    else if (!notify_theme ())
+    {
+        make_theme_alias (cur_conf.darkmode);
+        set_theme (alias_theme_name (cur_conf.darkmode));
+        reload_theme (FALSE);
+    }
+    g_free (cur);
 }
 
 static gboolean restore_theme (gpointer data)
 {
     /* Resets the theme to the default, causing it to take effect */
     set_theme (theme_name (cur_conf.darkmode));
-    if (data) gtk_main_quit ();
+    restore_id = 0;
+    if (data || quit_on_restore) gtk_main_quit ();
     return FALSE;
 }
 
 void reload_theme (long int quit)
 {
-    g_timeout_add (100, restore_theme, (gpointer) quit);
+    if (restore_id) g_source_remove (restore_id);
+    restore_id = g_timeout_add (100, restore_theme, (gpointer) quit);
+}
+
+/* Quits, but not before a pending switch back to the real theme */
+
+void quit_after_theme (void)
+{
+    if (restore_id) quit_on_restore = TRUE;
+    else gtk_main_quit ();
+}
+
+/* Shows the theme settings in this process's own windows, without writing
+ * anything or touching other applications - used while changes are staged */
+
+void preview_theme (void)
+{
+    int dark = cur_conf.darkmode;
+    char *cstrb, *cstrf, *cstrbb, *cstrbf, *css;
+
+    if (!preview_css)
+    {
+        preview_css = gtk_css_provider_new ();
+        gtk_style_context_add_provider_for_screen (gdk_screen_get_default (), GTK_STYLE_PROVIDER (preview_css),
+            GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    }
+
+    g_object_set (gtk_settings_get_default (), "gtk-theme-name", theme_name (dark),
+        "gtk-font-name", cur_conf.desktop_font, "gtk-cursor-theme-size", cur_conf.cursor_size, NULL);
+
+    cstrb = rgba_to_gdk_color_string (&cur_conf.theme_colour[dark]);
+    cstrf = rgba_to_gdk_color_string (&cur_conf.themetext_colour[dark]);
+    cstrbb = rgba_to_gdk_color_string (&cur_conf.bar_colour[dark]);
+    cstrbf = rgba_to_gdk_color_string (&cur_conf.bartext_colour[dark]);
+
+    css = g_strdup_printf ("@define-color theme_selected_bg_color %s;\n"
+        "@define-color theme_selected_fg_color %s;\n"
+        "@define-color bar_bg_color %s;\n"
+        "@define-color bar_fg_color %s;\n"
+        "scrollbar button { min-width: %dpx; min-height: %dpx; }\n"
+        "scrollbar slider { min-width: %dpx; min-height: %dpx; }\n",
+        cstrb, cstrf, cstrbb, cstrbf, cur_conf.scrollbar_width, cur_conf.scrollbar_width,
+        cur_conf.scrollbar_width - 6, cur_conf.scrollbar_width - 6);
+    gtk_css_provider_load_from_data (preview_css, css, -1, NULL);
+
+    g_free (css);
+    g_free (cstrf);
+    g_free (cstrb);
+    g_free (cstrbf);
+    g_free (cstrbb);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -1151,12 +1127,14 @@ void reload_theme (long int quit)
 
 void set_system_controls (void)
 {
+    // nothing to do if the tab has not been built yet
+    if (!font_system) return;
+
     // block widget handlers
     g_signal_handler_block (combo_cursor, id_cursor);
     g_signal_handler_block (rb_light, id_dark);
 
-    gtk_font_chooser_set_font (GTK_FONT_CHOOSER (font_system), cur_conf.desktop_font);
-    font_face = gtk_font_chooser_get_font_face (GTK_FONT_CHOOSER (font_system));
+    update_font_label ();
     gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (colour_hilite), &cur_conf.theme_colour[cur_conf.darkmode]);
     gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (colour_hilitetext), &cur_conf.themetext_colour[cur_conf.darkmode]);
 
@@ -1183,57 +1161,61 @@ static void on_theme_colour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.theme_colour[cur_conf.darkmode]);
 
-    save_session_settings ();
-    save_gtk3_settings ();
-    save_qt_settings ();
-
-    reload_session ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_THEME_COLOUR);
+    commit_changes ();
 }
 
 static void on_theme_textcolour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.themetext_colour[cur_conf.darkmode]);
 
-    save_session_settings ();
-    save_gtk3_settings ();
-    save_qt_settings ();
+    mark_dirty (CONF_THEMETEXT_COLOUR);
+    commit_changes ();
+}
+
+/* The font is shown on a plain button rather than a font button, as setting
+ * the font of a font button lists every installed family to find its face */
 
-    reload_session ();
-    reload_theme (FALSE);
+static void update_font_label (void)
+{
+    char *label;
+
+    if (!font_system) return;
+
+    label = font_label (cur_conf.desktop_font);
+    gtk_button_set_label (GTK_BUTTON (font_system), label);
+    g_free (label);
 }
 
-static void on_theme_font_set (GtkFontChooser *btn, gpointer ptr)
+static void on_theme_font_clicked (GtkButton *btn, gpointer ptr)
 {
-    int i;
-    PangoFontDescription *font_desc = gtk_font_chooser_get_font_desc (btn);
-    font_face = gtk_font_chooser_get_font_face (btn);
-    const char *font = gtk_font_chooser_get_font (btn);
+    GtkWidget *dlg, *top;
+
+    // the chooser lists the installed families, so is only created when needed
+    top = gtk_widget_get_toplevel (GTK_WIDGET (btn));
+    dlg = gtk_font_chooser_dialog_new (_("Pick a Font"), gtk_widget_is_toplevel (top) ? GTK_WINDOW (top) : NULL);
+    gtk_font_chooser_set_font (GTK_FONT_CHOOSER (dlg), cur_conf.desktop_font);
+
+    if (gtk_dialog_run (GTK_DIALOG (dlg)) == GTK_RESPONSE_OK) set_chosen_font (GTK_FONT_CHOOSER (dlg));
+    gtk_widget_destroy (dlg);
+}
+
+static void set_chosen_font (GtkFontChooser *chooser)
+{
+    const FontSpec *fs;
+    char *font = gtk_font_chooser_get_font (chooser);
     if (font)
     {
-        cur_conf.desktop_font = font;
+        cur_conf.desktop_font = take_conf_string (font);
 
-        int font_height = pango_font_description_get_size (font_desc);
-        if (!pango_font_description_get_size_is_absolute (font_desc))
-        {
-            font_height *= 4;
-            font_height /= 3;
-        }
-        font_height /= PANGO_SCALE;
-
-        cur_conf.scrollbar_width = font_height >= LARGE_ICON_THRESHOLD ? 17 : 13;
+        fs = set_font_spec (cur_conf.desktop_font, gtk_font_chooser_get_font_face (chooser));
+        cur_conf.scrollbar_width = fs->pixel_size >= LARGE_ICON_THRESHOLD ? 17 : 13;
+        update_font_label ();
     }
 
-    save_session_settings ();
-    for (i = 0; i < ndesks; i++)
-        save_pcman_settings (i);
-    save_qt_settings ();
-    save_greeter_settings ();
-
-    reload_session ();
-    reload_panel ();
-    reload_desktop ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_DESKTOP_FONT);
+    mark_dirty (CONF_SCROLLBAR_WIDTH);
+    commit_changes ();
 }
 
 static void on_theme_dark_set (GtkRadioButton *btn, gpointer ptr)
@@ -1265,14 +1247,8 @@ static void on_theme_dark_set (GtkRadioButton *btn, gpointer ptr)
     
     set_taskbar_controls ();
 
-    save_session_settings ();
-    save_gtk3_settings ();
-    save_qt_settings ();
-    save_app_settings ();
-    save_greeter_settings ();
-
-    reload_session ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_DARKMODE);
+    commit_changes ();
 }
 
 static void on_theme_cursor_size_set (GtkComboBox *btn, gpointer ptr)
@@ -1291,9 +1267,8 @@ static void on_theme_cursor_size_set (GtkComboBox *btn, gpointer ptr)
     if (wm == WM_OPENBOX && cur_conf.cursor_size != orig_csize) gtk_widget_show (label_cursor);
     else gtk_widget_hide (label_cursor);
 
-    save_session_settings ();
-    reload_session ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_CURSOR_SIZE);
+    commit_changes ();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -1310,19 +1285,26 @@ gboolean system_reboot (void)
 /* Initialisation                                                             */
 /*----------------------------------------------------------------------------*/
 
-void load_system_tab (GtkBuilder *builder)
+void load_system_settings (void)
 {
-    if (wm == WM_OPENBOX) load_lxsession_settings ();
-    else load_gsettings ();
-    load_obconf_settings ();
-    load_gtk3_settings ();
+    if (!restore_snapshot (SNAP_SESSION))
+    {
+        if (wm == WM_OPENBOX) load_lxsession_settings ();
+        else load_gsettings ();
+    }
+    if (!restore_snapshot (SNAP_WM)) load_obconf_settings ();
+    if (!restore_snapshot (SNAP_GTK3)) load_gtk3_settings ();
 
     orig_csize = cur_conf.cursor_size;
     orig_tbsize = cur_conf.tb_icon_size;
-    orig_font = g_strdup (cur_conf.desktop_font);
+    orig_font = cur_conf.desktop_font;
+}
 
+void load_system_tab (GtkBuilder *builder)
+{
     font_system = (GtkWidget *) gtk_builder_get_object (builder, "fontbutton1");
-    g_signal_connect (font_system, "font-set", G_CALLBACK (on_theme_font_set), NULL);
+    g_signal_connect (font_system, "clicked", G_CALLBACK (on_theme_font_clicked), NULL);
+    load_font_index (update_font_label);
 
     colour_hilite = (GtkWidget *) gtk_builder_get_object (builder, "colorbutton1");
     g_signal_connect (colour_hilite, "color-set", G_CALLBACK (on_theme_colour_set), NULL);
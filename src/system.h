@@ -42,6 +42,7 @@ extern void reload_session (void);
 extern void restore_gsettings (void);
 extern char *lxsession_file (gboolean global);
 extern char *xsettings_file (gboolean global);
+extern char *dconf_file (void);
 extern void save_session_settings (void);
 extern void save_gtk3_settings (void);
 extern void save_greeter_settings (void);
@@ -49,9 +50,15 @@ extern void save_qt_settings (void);
 extern void save_app_settings (void);
 extern void set_theme (const char *theme);
 extern int is_dark (void);
+extern void invalidate_dark_mode (void);
+extern char *get_theme (void);
+extern void refresh_theme (void);
 extern void reload_theme (long int quit);
+extern void quit_after_theme (void);
+extern void preview_theme (void);
 extern void set_system_controls (void);
 extern gboolean system_reboot (void);
+extern void load_system_settings (void);
 extern void load_system_tab (GtkBuilder *builder);
 
 /* End of file */
@@ -31,6 +31,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "desktop.h"
 #include "system.h"
 #include "defaults.h"
+#include "files.h"
+#include "snapshot.h"
+#include "schema.h"
+#include "commit.h"
 
 #include "taskbar.h"
 
@@ -47,7 +51,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /* Controls */
 static GtkWidget *colour_bar, *colour_bartext, *rb_top, *rb_bottom, *combo_size;
-static GtkWidget *combo_monitor;
+static GtkWidget *combo_monitor, *box_monitor;
 
 /* Handler IDs */
 static gulong id_size, id_pos, id_monitor;
@@ -56,7 +60,6 @@ static gulong id_size, id_pos, id_monitor;
 /* Prototypes                                                                 */
 /*----------------------------------------------------------------------------*/
 
-static char *wfpanel_file (gboolean global);
 static void load_lxpanel_settings (void);
 static void load_wfpanel_settings (void);
 static void save_lxpanel_settings (void);
@@ -89,7 +92,7 @@ char *lxpanel_file (gboolean global)
     return g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "lxpanel-pi", "panels/panel", NULL);
 }
 
-static char *wfpanel_file (gboolean global)
+char *wfpanel_file (gboolean global)
 {
     return g_build_filename (global ? "/etc/xdg" : g_get_user_config_dir (), "wf-panel-pi", "wf-panel-pi.ini", NULL);
 }
@@ -135,97 +138,15 @@ static void load_lxpanel_settings (void)
 
 static void load_wfpanel_settings (void)
 {
-    char *user_config_file, *ret;
-    GKeyFile *kf;
-    GError *err;
-    gint val;
+    char *user_config_file;
 
-    // read in data from file to a key file
+    // the system file gives every value, then the user file overrides any it sets
     user_config_file = wfpanel_file (TRUE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        ret = g_key_file_get_string (kf, "panel", "position", &err);
-        if (err == NULL && ret && !strcmp (ret, "bottom")) cur_conf.barpos = 1;
-        else DEFAULT (barpos);
-        g_free (ret);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "panel", "icon_size", &err);
-        if (err == NULL && val >= 16 && val <= 48) cur_conf.icon_size = val + 4;
-        else DEFAULT (icon_size);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "panel", "window-list_max_width", &err);
-        if (err == NULL) cur_conf.task_width = val;
-        else DEFAULT (task_width);
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "panel", "monitor", &err);
-        DEFAULT (monitor);
-        if (err == NULL && ret)
-        {
-            for (val = 0; val < ndesks; val++)
-            {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-                char *buf = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), val);
-#pragma GCC diagnostic pop
-                if (!g_strcmp0 (buf, ret)) cur_conf.monitor = val;
-                g_free (buf);
-            }
-        }
-    }
-    else
-    {
-        DEFAULT (barpos);
-        DEFAULT (icon_size);
-        DEFAULT (task_width);
-        DEFAULT (monitor);
-    }
-    g_key_file_free (kf);
+    load_fields (&wfpanel_schema, load_key_file (user_config_file, FALSE), &cur_conf, &def_med);
     g_free (user_config_file);
 
     user_config_file = wfpanel_file (FALSE);
-    kf = g_key_file_new ();
-    if (g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL))
-    {
-        // get data from the key file
-        err = NULL;
-        ret = g_key_file_get_string (kf, "panel", "position", &err);
-        if (err == NULL && ret)
-        {
-            if (!strcmp (ret, "bottom")) cur_conf.barpos = 1;
-            else cur_conf.barpos = 0;
-        }
-        g_free (ret);
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "panel", "icon_size", &err);
-        if (err == NULL && val >= 16 && val <= 48) cur_conf.icon_size = val + 4;
-
-        err = NULL;
-        val = g_key_file_get_integer (kf, "panel", "window-list_max_width", &err);
-        if (err == NULL) cur_conf.task_width = val;
-
-        err = NULL;
-        ret = g_key_file_get_string (kf, "panel", "monitor", &err);
-        if (err == NULL && ret)
-        {
-            for (val = 0; val < ndesks; val++)
-            {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-                char *buf = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), val);
-#pragma GCC diagnostic pop
-                if (!g_strcmp0 (buf, ret)) cur_conf.monitor = val;
-                g_free (buf);
-            }
-        }
-    }
-    g_key_file_free (kf);
+    overlay_fields (&wfpanel_schema, load_key_file (user_config_file, FALSE), &cur_conf);
     g_free (user_config_file);
 }
 
@@ -257,33 +178,17 @@ static void save_lxpanel_settings (void)
 
 static void save_wfpanel_settings (void)
 {
-    char *user_config_file, *str;
+    char *user_config_file;
     GKeyFile *kf;
-    gsize len;
 
     user_config_file = wfpanel_file (FALSE);
     check_directory (user_config_file);
 
     // process wfpanel config data
-    kf = g_key_file_new ();
-    g_key_file_load_from_file (kf, user_config_file, G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL);
-
-    g_key_file_set_string (kf, "panel", "position", cur_conf.barpos ? "bottom" : "top");
-    g_key_file_set_integer (kf, "panel", "icon_size", cur_conf.icon_size - 4);
-    g_key_file_set_integer (kf, "panel", "window-list_max_width", cur_conf.task_width);
+    kf = load_key_file (user_config_file, TRUE);
+    save_fields (&wfpanel_schema, kf, &cur_conf);
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-    char *buf = gdk_screen_get_monitor_plug_name (gdk_display_get_default_screen (gdk_display_get_default ()), cur_conf.monitor);
-#pragma GCC diagnostic pop
-    g_key_file_set_string (kf, "panel", "monitor", buf);
-    g_free (buf);
-
-    str = g_key_file_to_data (kf, &len, NULL);
-    g_file_set_contents (user_config_file, str, len, NULL);
-    g_free (str);
-
-    g_key_file_free (kf);
+    save_key_file (user_config_file);
     g_free (user_config_file);
 }
 
@@ -297,11 +202,33 @@ void save_panel_settings (void)
 /* Set controls to match data                                                 */
 /*----------------------------------------------------------------------------*/
 
+/* Stops the monitor list's handler seeing its rows being rebuilt */
+
+void block_taskbar_monitor (gboolean block)
+{
+    if (!combo_monitor) return;
+    if (block) g_signal_handler_block (combo_monitor, id_monitor);
+    else g_signal_handler_unblock (combo_monitor, id_monitor);
+}
+
+/* The monitor list is only shown if there is more than one monitor */
+
+void show_taskbar_monitors (void)
+{
+    if (!box_monitor) return;
+    if (ndesks > 1) gtk_widget_show_all (box_monitor);
+    else gtk_widget_hide (box_monitor);
+}
+
 void set_taskbar_controls (void)
 {
     GtkTreeIter iter;
+    gboolean valid;
     int val;
 
+    // nothing to do if the tab has not been built yet
+    if (!combo_size) return;
+
     g_signal_handler_block (combo_size, id_size);
     g_signal_handler_block (rb_top, id_pos);
     g_signal_handler_block (combo_monitor, id_monitor);
@@ -319,14 +246,14 @@ void set_taskbar_controls (void)
 
     if (ndesks > 1)
     {
-        gtk_tree_model_get_iter_first (GTK_TREE_MODEL (sortmons), &iter);
-        gtk_tree_model_get (GTK_TREE_MODEL (sortmons), &iter, 0, &val, -1);
-        while (val != cur_conf.monitor)
+        valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (sortmons), &iter);
+        while (valid)
         {
-            gtk_tree_model_iter_next (GTK_TREE_MODEL (sortmons), &iter);
             gtk_tree_model_get (GTK_TREE_MODEL (sortmons), &iter, 0, &val, -1);
+            if (val == cur_conf.monitor) break;
+            valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (sortmons), &iter);
         }
-        gtk_combo_box_set_active_iter (GTK_COMBO_BOX (combo_monitor), &iter);
+        if (valid) gtk_combo_box_set_active_iter (GTK_COMBO_BOX (combo_monitor), &iter);
     }
 
     g_signal_handler_unblock (rb_top, id_pos);
@@ -357,9 +284,9 @@ static void on_bar_size_set (GtkComboBox *btn, gpointer ptr)
                     break;
     }
 
-    save_panel_settings ();
-    if (wm != WM_OPENBOX) reload_desktop ();
-    reload_panel ();
+    mark_dirty (CONF_ICON_SIZE);
+    mark_dirty (CONF_TASK_WIDTH);
+    commit_changes ();
 }
 
 static void on_bar_pos_set (GtkRadioButton *btn, gpointer ptr)
@@ -367,9 +294,8 @@ static void on_bar_pos_set (GtkRadioButton *btn, gpointer ptr)
     if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (btn))) cur_conf.barpos = 0;
     else cur_conf.barpos = 1;
 
-    save_panel_settings ();
-    if (wm != WM_OPENBOX) reload_desktop ();
-    reload_panel ();
+    mark_dirty (CONF_BARPOS);
+    commit_changes ();
 }
 
 static void on_bar_loc_set (GtkComboBox *cb, gpointer ptr)
@@ -379,35 +305,39 @@ static void on_bar_loc_set (GtkComboBox *cb, gpointer ptr)
     gtk_combo_box_get_active_iter (cb, &iter);
     gtk_tree_model_get (GTK_TREE_MODEL (sortmons), &iter, 0, &cur_conf.monitor, -1);
 
-    save_panel_settings ();
-    if (wm != WM_OPENBOX) reload_desktop ();
-    reload_panel ();
+    mark_dirty (CONF_MONITOR);
+    commit_changes ();
 }
 
 static void on_bar_colour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.bar_colour[cur_conf.darkmode]);
-    set_theme (theme_name (TEMP));
-    save_gtk3_settings ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_BAR_COLOUR);
+    commit_changes ();
 }
 
 static void on_bar_textcolour_set (GtkColorChooser *btn, gpointer ptr)
 {
     gtk_color_chooser_get_rgba (btn, &cur_conf.bartext_colour[cur_conf.darkmode]);
-    set_theme (theme_name (TEMP));
-    save_gtk3_settings ();
-    reload_theme (FALSE);
+    mark_dirty (CONF_BARTEXT_COLOUR);
+    commit_changes ();
 }
 
 /*----------------------------------------------------------------------------*/
 /* Initialisation                                                             */
 /*----------------------------------------------------------------------------*/
 
-void load_taskbar_tab (GtkBuilder *builder)
+void load_taskbar_settings (void)
 {
+    if (restore_snapshot (SNAP_TASKBAR)) return;
+
     if (wm != WM_OPENBOX) load_wfpanel_settings ();
     else load_lxpanel_settings ();
+}
+
+void load_taskbar_tab (GtkBuilder *builder)
+{
+    GtkCellRenderer *rend;
 
     colour_bar = (GtkWidget *) gtk_builder_get_object (builder, "colorbutton3");
     g_signal_connect (colour_bar, "color-set", G_CALLBACK (on_bar_colour_set), NULL);
@@ -425,20 +355,14 @@ void load_taskbar_tab (GtkBuilder *builder)
     combo_size = (GtkWidget *) gtk_builder_get_object (builder, "comboboxtext2");
     id_size = g_signal_connect (combo_size, "changed", G_CALLBACK (on_bar_size_set), NULL);
 
-    if (ndesks > 1)
-    {
-        GtkCellRenderer *rend = gtk_cell_renderer_text_new ();
-
-        gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo_monitor), rend, FALSE);
-        gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (combo_monitor), rend, "text", 1);
-        gtk_combo_box_set_model (GTK_COMBO_BOX (combo_monitor), GTK_TREE_MODEL (sortmons));
+    // the list is set up even for one monitor, so it is ready if another is plugged in
+    rend = gtk_cell_renderer_text_new ();
+    gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (combo_monitor), rend, FALSE);
+    gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (combo_monitor), rend, "text", 1);
+    gtk_combo_box_set_model (GTK_COMBO_BOX (combo_monitor), GTK_TREE_MODEL (sortmons));
 
-        gtk_widget_show_all (GTK_WIDGET (gtk_builder_get_object (builder, "hbox25")));
-    }
-    else
-    {
-        gtk_widget_hide (GTK_WIDGET (gtk_builder_get_object (builder, "hbox25")));
-    }
+    box_monitor = (GtkWidget *) gtk_builder_get_object (builder, "hbox25");
+    show_taskbar_monitors ();
 }
 
 /* End of file */
@@ -38,8 +38,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 extern void reload_panel (void);
 extern char *lxpanel_file (gboolean global);
+extern char *wfpanel_file (gboolean global);
 extern void save_panel_settings (void);
+extern void block_taskbar_monitor (gboolean block);
+extern void show_taskbar_monitors (void);
 extern void set_taskbar_controls (void);
+extern void load_taskbar_settings (void);
 extern void load_taskbar_tab (GtkBuilder *builder);
 
 /* End of file */
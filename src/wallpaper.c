@@ -0,0 +1,624 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "files.h"
+#include "desktop.h"
+
+#include "wallpaper.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* Changing this makes every rendered wallpaper stale */
+#define RENDER_VERSION 1
+
+/* Largest dimension of the copy of a picture which its colours are taken from */
+#define COLOUR_SAMPLE 64
+
+/* Colour histogram bins - 4 bits of each channel */
+#define COLOUR_BINS 4096
+
+/* A wallpaper to be rendered at the size of a monitor */
+typedef struct {
+    char *source;
+    char *mode;
+    GdkRGBA colour;
+    int width;
+    int height;
+    char *target;
+    gboolean done;
+    guint idle;
+} RenderJob;
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Worker pool which renders wallpapers */
+static GThreadPool *pool;
+
+/* Renders queued or running, by target - only used on the main thread */
+static GHashTable *pending;
+
+/* Finished jobs waiting for the main loop - removed when the plugin is freed,
+ * so that none can run after it */
+static GSList *ready;
+static GMutex ready_lock;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static char *render_dir (void);
+static gboolean desktop_size (int desktop, int *width, int *height);
+static gboolean needs_scaling (const char *picture, const char *mode, int width, int height);
+static char *render_target (int desktop);
+static GdkPixbuf *load_scaled (RenderJob *job);
+static gboolean render_job (RenderJob *job);
+static void render_worker (gpointer data, gpointer user_data);
+static gboolean render_ready (gpointer data);
+static void free_job (RenderJob *job);
+static char *colour_cache_file (void);
+static gboolean sample_colours (const char *picture, GdkRGBA *dominant, GdkRGBA *edge);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static char *render_dir (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "pipanel", "wallpaper", NULL);
+}
+
+static char *colour_cache_file (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "pipanel", "wallpaper", "colours.conf", NULL);
+}
+
+/* A common wallpaper can only be rendered once if every monitor is the same size */
+
+static gboolean desktop_size (int desktop, int *width, int *height)
+{
+    int i;
+
+    *width = monitors[desktop].width;
+    *height = monitors[desktop].height;
+
+    if (cur_conf.common_bg)
+    {
+        for (i = 0; i < ndesks; i++)
+            if (monitors[i].width != *width || monitors[i].height != *height) return FALSE;
+    }
+
+    return *width > 0 && *height > 0;
+}
+
+/* Only a picture which pcmanfm would have to scale is worth rendering - one
+ * shown at its own size costs pcmanfm no more than the render would, and is
+ * better not decoded and encoded again */
+
+static gboolean needs_scaling (const char *picture, const char *mode, int width, int height)
+{
+    int sw, sh;
+
+    if (!strcmp (mode, "center") || !strcmp (mode, "tile")) return FALSE;
+    if (!gdk_pixbuf_get_file_info (picture, &sw, &sh) || sw <= 0 || sh <= 0) return FALSE;
+
+    if (!strcmp (mode, "stretch")) return sw != width || sh != height;
+    if (!strcmp (mode, "fit")) return (sw != width || sh > height) && (sh != height || sw > width);
+    if (!strcmp (mode, "crop")) return (sw != width || sh < height) && (sh != height || sw < width);
+    return FALSE;
+}
+
+/* Returns the file a desktop's wallpaper is rendered to, which is named from
+ * everything the rendered image depends on, or NULL if it is shown as it is */
+
+static char *render_target (int desktop)
+{
+    DesktopConfig *dc = &cur_conf.desktops[desktop];
+    char *stamp, *colour, *key, *md5, *name, *dir, *path, *type;
+    int width, height;
+
+    if (!dc->desktop_picture || !dc->desktop_picture[0] || !dc->desktop_mode) return NULL;
+    if (!strcmp (dc->desktop_mode, "color")) return NULL;
+    if (!desktop_size (desktop, &width, &height)) return NULL;
+    if (!needs_scaling (dc->desktop_picture, dc->desktop_mode, width, height)) return NULL;
+
+    stamp = file_stamp (dc->desktop_picture);
+    if (!strcmp (stamp, "0"))
+    {
+        g_free (stamp);
+        return NULL;
+    }
+
+    colour = rgba_to_gdk_color_string (&dc->desktop_colour);
+    key = g_strdup_printf ("%d %s %s %s %s %dx%d", RENDER_VERSION, stamp, dc->desktop_picture,
+        dc->desktop_mode, colour, width, height);
+    md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, key, -1);
+
+    // photos are kept as JPEG, anything else as PNG so that sharp edges survive
+    type = g_content_type_guess (dc->desktop_picture, NULL, 0, NULL);
+    name = g_strconcat (md5, g_strcmp0 (type, "image/jpeg") ? ".png" : ".jpg", NULL);
+    dir = render_dir ();
+    path = g_build_filename (dir, name, NULL);
+
+    g_free (dir);
+    g_free (type);
+    g_free (name);
+    g_free (md5);
+    g_free (key);
+    g_free (colour);
+    g_free (stamp);
+    return path;
+}
+
+/* Loads the picture at the size it will be shown at - loading at scale lets
+ * the JPEG loader use libjpeg-turbo's SIMD scaled decode, so a large photo is
+ * never decoded in full just to be shrunk */
+
+static GdkPixbuf *load_scaled (RenderJob *job)
+{
+    int sw, sh;
+    double xs, ys, scale;
+
+    if (!gdk_pixbuf_get_file_info (job->source, &sw, &sh) || sw <= 0 || sh <= 0) return NULL;
+
+    if (!strcmp (job->mode, "stretch"))
+        return gdk_pixbuf_new_from_file_at_scale (job->source, job->width, job->height, FALSE, NULL);
+
+    // only fitted and cropped pictures are left, as nothing else is rendered
+    xs = (double) job->width / sw;
+    ys = (double) job->height / sh;
+    scale = !strcmp (job->mode, "fit") ? MIN (xs, ys) : MAX (xs, ys);
+    return gdk_pixbuf_new_from_file_at_scale (job->source, MAX (1, (int) (sw * scale + 0.5)),
+        MAX (1, (int) (sh * scale + 0.5)), FALSE, NULL);
+}
+
+/* Composites the picture onto the background colour just as pcmanfm would, so
+ * that pcmanfm only has to load an image which already fills the monitor */
+
+static gboolean render_job (RenderJob *job)
+{
+    GdkPixbuf *pixbuf, *out;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    char *tmp;
+    gboolean res;
+
+    pixbuf = load_scaled (job);
+    if (!pixbuf) return FALSE;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, job->width, job->height);
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, job->colour.red, job->colour.green, job->colour.blue);
+    cairo_paint (cr);
+    gdk_cairo_set_source_pixbuf (cr, pixbuf, (job->width - gdk_pixbuf_get_width (pixbuf)) / 2,
+        (job->height - gdk_pixbuf_get_height (pixbuf)) / 2);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    g_object_unref (pixbuf);
+
+    out = gdk_pixbuf_get_from_surface (surface, 0, 0, job->width, job->height);
+    cairo_surface_destroy (surface);
+    if (!out) return FALSE;
+
+    // written under a temporary name, so pcmanfm never sees part of a file
+    check_directory (job->target);
+    tmp = g_strconcat (job->target, ".tmp", NULL);
+    if (g_str_has_suffix (job->target, ".jpg")) res = gdk_pixbuf_save (out, tmp, "jpeg", NULL, "quality", "95", NULL);
+    else res = gdk_pixbuf_save (out, tmp, "png", NULL, NULL);
+    if (res && g_rename (tmp, job->target)) res = FALSE;
+    if (!res) g_remove (tmp);
+    g_free (tmp);
+    g_object_unref (out);
+
+    return res;
+}
+
+static void render_worker (gpointer data, gpointer user_data)
+{
+    RenderJob *job = (RenderJob *) data;
+
+    job->done = render_job (job);
+
+    // the desktop files are repointed on the main thread
+    g_mutex_lock (&ready_lock);
+    job->idle = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, render_ready, job, (GDestroyNotify) free_job);
+    ready = g_slist_prepend (ready, job);
+    g_mutex_unlock (&ready_lock);
+}
+
+/* Points each desktop file which still shows the picture a render was made
+ * from at the render, and reloads pcmanfm if any was - a desktop whose settings
+ * have changed since the render was queued no longer wants it, and is left */
+
+static gboolean render_ready (gpointer data)
+{
+    RenderJob *job = (RenderJob *) data;
+    DesktopConfig *dc;
+    GKeyFile *kf;
+    char *target, *path, *val;
+    gboolean repointed = FALSE;
+    int i;
+
+    g_mutex_lock (&ready_lock);
+    ready = g_slist_remove (ready, job);
+    g_mutex_unlock (&ready_lock);
+    g_hash_table_remove (pending, job->target);
+
+    if (!job->done) return FALSE;
+
+    for (i = 0; i < (cur_conf.common_bg ? 1 : ndesks); i++)
+    {
+        target = render_target (i);
+        if (!g_strcmp0 (target, job->target))
+        {
+            dc = &cur_conf.desktops[i];
+            path = pcmanfm_file (FALSE, i, FALSE);
+            kf = load_key_file (path, FALSE);
+            val = kf ? g_key_file_get_string (kf, "*", "wallpaper", NULL) : NULL;
+            if (!g_strcmp0 (val, dc->desktop_picture))
+            {
+                g_key_file_set_string (kf, "*", "wallpaper", job->target);
+                save_key_file (path);
+                repointed = TRUE;
+            }
+            g_free (val);
+            g_free (path);
+        }
+        g_free (target);
+    }
+
+    if (repointed) reload_desktop ();
+    return FALSE;
+}
+
+static void free_job (RenderJob *job)
+{
+    g_free (job->source);
+    g_free (job->mode);
+    g_free (job->target);
+    g_free (job);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Rendered wallpapers                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* Queues a render of any desktop's wallpaper which has not already been
+ * rendered for its current picture, mode, colour and monitor size. The desktop
+ * files are written straight away with the picture itself, and each is pointed
+ * at its render once that is done, so the main loop never waits for one */
+
+void render_wallpapers (void)
+{
+    RenderJob *job;
+    char *target;
+    int i;
+
+    if (!pool) pool = g_thread_pool_new (render_worker, NULL, g_get_num_processors (), FALSE, NULL);
+    if (!pending) pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    for (i = 0; i < (cur_conf.common_bg ? 1 : ndesks); i++)
+    {
+        // monitors of the same size showing the same picture share a file
+        target = render_target (i);
+        if (!target || g_file_test (target, G_FILE_TEST_EXISTS) || g_hash_table_contains (pending, target))
+        {
+            g_free (target);
+            continue;
+        }
+
+        job = g_new0 (RenderJob, 1);
+        job->source = g_strdup (cur_conf.desktops[i].desktop_picture);
+        job->mode = g_strdup (cur_conf.desktops[i].desktop_mode);
+        job->colour = cur_conf.desktops[i].desktop_colour;
+        desktop_size (i, &job->width, &job->height);
+        job->target = target;
+        g_hash_table_add (pending, g_strdup (target));
+        g_thread_pool_push (pool, job, NULL);
+    }
+}
+
+/* Returns the file to give pcmanfm as a desktop's wallpaper - the rendered
+ * copy if there is one, otherwise the picture itself */
+
+char *wallpaper_file (int desktop)
+{
+    char *target = render_target (desktop);
+
+    if (target && g_file_test (target, G_FILE_TEST_EXISTS)) return target;
+    g_free (target);
+    return g_strdup (cur_conf.desktops[desktop].desktop_picture);
+}
+
+gboolean is_rendered_wallpaper (const char *path)
+{
+    char *dir = render_dir ();
+    gboolean res = path && g_str_has_prefix (path, dir) && path[strlen (dir)] == '/';
+
+    g_free (dir);
+    return res;
+}
+
+/* Removes rendered wallpapers which no pcmanfm profile refers to - this is only
+ * done at startup, as the files backed up for cancel may refer to any of the
+ * files rendered since. As the renders are only a cache, a profile whose render
+ * has gone is pointed back at the picture it was made from; returns whether
+ * any was, so that pcmanfm can be reloaded */
+
+gboolean clean_wallpapers (void)
+{
+    GHashTable *used;
+    GKeyFile *kf;
+    GDir *profiles, *dir;
+    const char *profile, *name;
+    char *base, *pdir, *path, *val, *src, *stamp, *cached, **groups;
+    gboolean changed = FALSE, repointed = FALSE;
+    int i;
+
+    used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    base = g_build_filename (g_get_user_config_dir (), "pcmanfm", NULL);
+    profiles = g_dir_open (base, 0, NULL);
+    if (profiles)
+    {
+        while ((profile = g_dir_read_name (profiles)))
+        {
+            pdir = g_build_filename (base, profile, NULL);
+            dir = g_dir_open (pdir, 0, NULL);
+            if (dir)
+            {
+                while ((name = g_dir_read_name (dir)))
+                {
+                    if (!g_str_has_prefix (name, "desktop-items") || !g_str_has_suffix (name, ".conf")) continue;
+                    path = g_build_filename (pdir, name, NULL);
+                    kf = g_key_file_new ();
+                    if (g_key_file_load_from_file (kf, path, G_KEY_FILE_KEEP_COMMENTS, NULL)
+                        && (val = g_key_file_get_string (kf, "*", "wallpaper", NULL)))
+                    {
+                        src = g_key_file_get_string (kf, "*", "wallpaper_source", NULL);
+                        if (is_rendered_wallpaper (val) && !g_file_test (val, G_FILE_TEST_EXISTS) && src)
+                        {
+                            g_key_file_set_string (kf, "*", "wallpaper", src);
+                            g_key_file_save_to_file (kf, path, NULL);
+                            repointed = TRUE;
+                        }
+                        g_free (src);
+                        g_hash_table_add (used, val);
+                    }
+                    g_key_file_free (kf);
+                    g_free (path);
+                }
+                g_dir_close (dir);
+            }
+            g_free (pdir);
+        }
+        g_dir_close (profiles);
+    }
+    g_free (base);
+
+    base = render_dir ();
+    dir = g_dir_open (base, 0, NULL);
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)))
+        {
+            path = g_build_filename (base, name, NULL);
+            if (!g_hash_table_contains (used, path) && strcmp (name, "colours.conf")) g_remove (path);
+            g_free (path);
+        }
+        g_dir_close (dir);
+    }
+    g_free (base);
+
+    g_hash_table_destroy (used);
+
+    // drop the colours of pictures which have since changed or gone
+    path = colour_cache_file ();
+    kf = g_key_file_new ();
+    if (g_key_file_load_from_file (kf, path, G_KEY_FILE_NONE, NULL))
+    {
+        groups = g_key_file_get_groups (kf, NULL);
+        for (i = 0; groups[i]; i++)
+        {
+            val = g_key_file_get_string (kf, groups[i], "picture", NULL);
+            stamp = file_stamp (val ? val : "");
+            cached = g_key_file_get_string (kf, groups[i], "stamp", NULL);
+            if (!val || g_strcmp0 (stamp, cached))
+            {
+                g_key_file_remove_group (kf, groups[i], NULL);
+                changed = TRUE;
+            }
+            g_free (cached);
+            g_free (stamp);
+            g_free (val);
+        }
+        g_strfreev (groups);
+        if (changed) g_key_file_save_to_file (kf, path, NULL);
+    }
+    g_key_file_free (kf);
+    g_free (path);
+
+    return repointed;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Wallpaper colours                                                          */
+/*----------------------------------------------------------------------------*/
+
+/* Finds the most common colour of a picture, and the average colour of its
+ * edges, from a thumbnail-sized copy - decoding at that size is nearly all of
+ * the cost, and a histogram of a few thousand pixels needs no more than a
+ * plain loop */
+
+static gboolean sample_colours (const char *picture, GdkRGBA *dominant, GdkRGBA *edge)
+{
+    GdkPixbuf *pixbuf;
+    guint32 *count, *sum, esum[3] = { 0, 0, 0 }, ecount = 0;
+    const guchar *pixels, *p;
+    int width, height, stride, nch, x, y, bin, best = 0;
+
+    pixbuf = gdk_pixbuf_new_from_file_at_scale (picture, COLOUR_SAMPLE, COLOUR_SAMPLE, TRUE, NULL);
+    if (!pixbuf) return FALSE;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    stride = gdk_pixbuf_get_rowstride (pixbuf);
+    nch = gdk_pixbuf_get_n_channels (pixbuf);
+    pixels = gdk_pixbuf_read_pixels (pixbuf);
+
+    count = g_new0 (guint32, COLOUR_BINS);
+    sum = g_new0 (guint32, COLOUR_BINS * 3);
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            p = pixels + y * stride + x * nch;
+
+            // mostly transparent pixels are not seen
+            if (nch == 4 && p[3] < 128) continue;
+
+            bin = ((p[0] >> 4) << 8) | ((p[1] >> 4) << 4) | (p[2] >> 4);
+            count[bin]++;
+            sum[bin * 3] += p[0];
+            sum[bin * 3 + 1] += p[1];
+            sum[bin * 3 + 2] += p[2];
+            if (count[bin] > count[best]) best = bin;
+
+            if (x == 0 || y == 0 || x == width - 1 || y == height - 1)
+            {
+                esum[0] += p[0];
+                esum[1] += p[1];
+                esum[2] += p[2];
+                ecount++;
+            }
+        }
+    }
+    g_object_unref (pixbuf);
+
+    if (count[best])
+    {
+        // the average of the pixels in the fullest bin, rather than its centre
+        dominant->red = sum[best * 3] / (255.0 * count[best]);
+        dominant->green = sum[best * 3 + 1] / (255.0 * count[best]);
+        dominant->blue = sum[best * 3 + 2] / (255.0 * count[best]);
+        dominant->alpha = 1.0;
+    }
+    g_free (count);
+    g_free (sum);
+    if (!ecount) return FALSE;
+
+    edge->red = esum[0] / (255.0 * ecount);
+    edge->green = esum[1] / (255.0 * ecount);
+    edge->blue = esum[2] / (255.0 * ecount);
+    edge->alpha = 1.0;
+    return TRUE;
+}
+
+/* Suggests a background colour for a picture - the colour of its edges when
+ * it is centred or fitted, as that is what the background borders, and its
+ * most common colour otherwise. The colours are cached next to the rendered
+ * wallpapers, so are only worked out once for each version of a picture */
+
+gboolean wallpaper_colour (const char *picture, const char *mode, GdkRGBA *colour)
+{
+    GKeyFile *kf;
+    GdkRGBA dominant, edge;
+    char *path, *group, *stamp, *cached;
+    gboolean res = FALSE;
+
+    if (!picture || !picture[0]) return FALSE;
+    stamp = file_stamp (picture);
+    if (!strcmp (stamp, "0"))
+    {
+        g_free (stamp);
+        return FALSE;
+    }
+
+    path = colour_cache_file ();
+    group = g_compute_checksum_for_string (G_CHECKSUM_MD5, picture, -1);
+    kf = g_key_file_new ();
+    g_key_file_load_from_file (kf, path, G_KEY_FILE_NONE, NULL);
+
+    cached = g_key_file_get_string (kf, group, "stamp", NULL);
+    if (!g_strcmp0 (cached, stamp) && get_key_colour (kf, group, "dominant", &dominant)
+        && get_key_colour (kf, group, "edge", &edge))
+        res = TRUE;
+    else if (sample_colours (picture, &dominant, &edge))
+    {
+        g_key_file_set_string (kf, group, "picture", picture);
+        g_key_file_set_string (kf, group, "stamp", stamp);
+        set_key_colour (kf, group, "dominant", &dominant);
+        set_key_colour (kf, group, "edge", &edge);
+
+        check_directory (path);
+        g_key_file_save_to_file (kf, path, NULL);
+        res = TRUE;
+    }
+    g_free (cached);
+    g_key_file_free (kf);
+    g_free (group);
+    g_free (path);
+    g_free (stamp);
+
+    if (res) *colour = (!g_strcmp0 (mode, "center") || !g_strcmp0 (mode, "fit")) ? edge : dominant;
+    return res;
+}
+
+void free_wallpapers (void)
+{
+    GSList *jobs;
+
+    // queued renders are dropped, and running ones finished
+    if (pool) g_thread_pool_free (pool, TRUE, TRUE);
+    pool = NULL;
+
+    jobs = ready;
+    ready = NULL;
+    while (jobs)
+    {
+        g_source_remove (((RenderJob *) jobs->data)->idle);
+        jobs = g_slist_delete_link (jobs, jobs);
+    }
+
+    if (pending) g_hash_table_destroy (pending);
+    pending = NULL;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
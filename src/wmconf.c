@@ -0,0 +1,341 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+#include <sys/stat.h>
+#include <gtk/gtk.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+
+#include "pipanel.h"
+#include "files.h"
+
+#include "wmconf.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define XP_THEME "/*[local-name()='openbox_config']/*[local-name()='theme']"
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/* Element names of the single-valued theme settings, indexed by wm_value */
+static const char *value_tags[WM_N_VALUES] = { "name", "invHandleWidth", "titleColor", "textColor" };
+
+/* Compiled XPath expressions */
+static xmlXPathCompExprPtr xp_root, xp_theme, xp_font, xp_values[WM_N_VALUES];
+
+/* Parsed document and the stat data of the file it was read from */
+static char *wm_path;
+static xmlDocPtr wm_doc;
+static xmlXPathContextPtr wm_ctx;
+static ino_t wm_inode;
+static off_t wm_size;
+static struct timespec wm_mtime;
+
+/* Node handles */
+static xmlNodePtr root_node, theme_node, value_nodes[WM_N_VALUES];
+static GPtrArray *font_nodes;
+
+/* Set when the document differs from the file */
+static gboolean wm_dirty;
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static void compile_xpaths (void);
+static xmlNodePtr find_node (xmlXPathCompExprPtr xpath);
+static void find_nodes (void);
+static void close_doc (void);
+static void open_doc (void);
+static void create_theme_node (void);
+static void set_content (xmlNodePtr node, const char *value);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+static void compile_xpaths (void)
+{
+    char *xpath;
+    int val;
+
+    if (xp_root) return;
+
+    xmlInitParser ();
+    LIBXML_TEST_VERSION
+
+    xp_root = xmlXPathCompile (XC ("/*[local-name()='openbox_config']"));
+    xp_theme = xmlXPathCompile (XC (XP_THEME));
+    xp_font = xmlXPathCompile (XC (XP_THEME "/*[local-name()='font']"));
+    for (val = 0; val < WM_N_VALUES; val++)
+    {
+        xpath = g_strdup_printf (XP_THEME "/*[local-name()='%s']", value_tags[val]);
+        xp_values[val] = xmlXPathCompile (XC (xpath));
+        g_free (xpath);
+    }
+}
+
+static xmlNodePtr find_node (xmlXPathCompExprPtr xpath)
+{
+    xmlXPathObjectPtr xpathObj;
+    xmlNodePtr node = NULL;
+
+    xpathObj = xmlXPathCompiledEval (xpath, wm_ctx);
+    if (xpathObj && !xmlXPathNodeSetIsEmpty (xpathObj->nodesetval)) node = xpathObj->nodesetval->nodeTab[0];
+    xmlXPathFreeObject (xpathObj);
+    return node;
+}
+
+static void find_nodes (void)
+{
+    xmlXPathObjectPtr xpathObj;
+    int val;
+
+    root_node = find_node (xp_root);
+    theme_node = find_node (xp_theme);
+    for (val = 0; val < WM_N_VALUES; val++) value_nodes[val] = find_node (xp_values[val]);
+
+    g_ptr_array_set_size (font_nodes, 0);
+    xpathObj = xmlXPathCompiledEval (xp_font, wm_ctx);
+    if (xpathObj && !xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
+    {
+        for (val = 0; val < xpathObj->nodesetval->nodeNr; val++)
+            g_ptr_array_add (font_nodes, xpathObj->nodesetval->nodeTab[val]);
+    }
+    xmlXPathFreeObject (xpathObj);
+}
+
+static void close_doc (void)
+{
+    if (wm_ctx) xmlXPathFreeContext (wm_ctx);
+    if (wm_doc) xmlFreeDoc (wm_doc);
+    wm_ctx = NULL;
+    wm_doc = NULL;
+    wm_dirty = FALSE;
+}
+
+/* Makes sure the document matches the file on disk - it is only reparsed if
+ * the file has been replaced or modified since it was last read or written */
+
+static void open_doc (void)
+{
+    struct stat st;
+    gboolean exists;
+
+    if (!wm_path)
+    {
+        wm_path = wm_config_file ();
+        font_nodes = g_ptr_array_new ();
+    }
+
+    exists = (stat (wm_path, &st) == 0 && S_ISREG (st.st_mode));
+    if (wm_doc)
+    {
+        if (exists && st.st_ino == wm_inode && st.st_size == wm_size
+            && st.st_mtim.tv_sec == wm_mtime.tv_sec && st.st_mtim.tv_nsec == wm_mtime.tv_nsec) return;
+        if (!exists && wm_inode == 0) return;
+        close_doc ();
+    }
+
+    compile_xpaths ();
+
+    if (exists) wm_doc = xmlParseFile (wm_path);
+    if (!wm_doc) wm_doc = xmlNewDoc (XC ("1.0"));
+    wm_ctx = xmlXPathNewContext (wm_doc);
+
+    if (exists)
+    {
+        wm_inode = st.st_ino;
+        wm_size = st.st_size;
+        wm_mtime = st.st_mtim;
+    }
+    else wm_inode = 0;
+
+    find_nodes ();
+}
+
+static void create_theme_node (void)
+{
+    if (!root_node)
+    {
+        root_node = xmlNewNode (NULL, XC ("openbox_config"));
+        xmlDocSetRootElement (wm_doc, root_node);
+        xmlNewNs (root_node, XC ("http://openbox.org/3.4/rc"), NULL);
+        wm_dirty = TRUE;
+    }
+
+    if (!theme_node)
+    {
+        theme_node = xmlNewChild (root_node, NULL, XC ("theme"), NULL);
+        wm_dirty = TRUE;
+    }
+}
+
+static void set_content (xmlNodePtr node, const char *value)
+{
+    xmlChar *cur = xmlNodeGetContent (node);
+
+    if (xmlStrcmp (cur, XC (value)))
+    {
+        xmlNodeSetContent (node, XC (value));
+        wm_dirty = TRUE;
+    }
+    xmlFree (cur);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Access to theme settings                                                   */
+/*----------------------------------------------------------------------------*/
+
+char *wm_config_file (void)
+{
+    if (wm == WM_LABWC) return g_build_filename (g_get_user_config_dir (), "labwc", "rc.xml", NULL);
+    else return g_build_filename (g_get_user_config_dir (), "openbox", "rpd-rc.xml", NULL);
+}
+
+char *get_wm_value (wm_value val)
+{
+    xmlChar *content;
+    char *res;
+
+    open_doc ();
+    if (!value_nodes[val]) return NULL;
+
+    content = xmlNodeGetContent (value_nodes[val]);
+    res = g_strdup ((const char *) content);
+    xmlFree (content);
+    return res;
+}
+
+void set_wm_value (wm_value val, const char *value)
+{
+    open_doc ();
+    create_theme_node ();
+
+    if (!value_nodes[val])
+    {
+        value_nodes[val] = xmlNewChild (theme_node, NULL, XC (value_tags[val]), XC (value));
+        wm_dirty = TRUE;
+    }
+    else set_content (value_nodes[val], value);
+}
+
+void set_wm_font (const char *font, const char *size, const char *weight, const char *slant)
+{
+    xmlNodePtr node;
+    int count;
+
+    open_doc ();
+    create_theme_node ();
+
+    if (font_nodes->len == 0)
+    {
+        for (count = 0; count < 2; count++)
+        {
+            node = xmlNewChild (theme_node, NULL, XC ("font"), NULL);
+
+            xmlSetProp (node, XC ("place"), count == 0 ? XC ("ActiveWindow") : XC ("InactiveWindow"));
+            xmlNewChild (node, NULL, XC ("name"), XC (font));
+            xmlNewChild (node, NULL, XC ("size"), XC (size));
+            xmlNewChild (node, NULL, XC ("weight"), XC (weight));
+            xmlNewChild (node, NULL, XC ("slant"), XC (slant));
+            g_ptr_array_add (font_nodes, node);
+        }
+        wm_dirty = TRUE;
+        return;
+    }
+
+    for (count = 0; count < font_nodes->len; count++)
+    {
+        for (node = ((xmlNodePtr) g_ptr_array_index (font_nodes, count))->children; node; node = node->next)
+        {
+            if (node->type == XML_ELEMENT_NODE)
+            {
+                if (!xmlStrcmp (node->name, XC ("name"))) set_content (node, font);
+                if (!xmlStrcmp (node->name, XC ("size"))) set_content (node, size);
+                if (!xmlStrcmp (node->name, XC ("weight"))) set_content (node, weight);
+                if (!xmlStrcmp (node->name, XC ("slant"))) set_content (node, slant);
+            }
+        }
+    }
+}
+
+/* Writes the document out, but only if something in it has changed */
+
+void save_wm_config (void)
+{
+    struct stat st;
+    xmlChar *buf;
+    int len;
+    gboolean res;
+
+    if (!wm_doc || !wm_dirty) return;
+
+    check_directory (wm_path);
+    xmlDocDumpMemory (wm_doc, &buf, &len);
+    if (!buf) return;
+    res = write_contents (wm_path, (const char *) buf, len);
+    xmlFree (buf);
+    if (!res) return;
+    wm_dirty = FALSE;
+
+    if (stat (wm_path, &st) == 0)
+    {
+        wm_inode = st.st_ino;
+        wm_size = st.st_size;
+        wm_mtime = st.st_mtim;
+    }
+}
+
+void free_wm_config (void)
+{
+    int val;
+
+    close_doc ();
+    g_free (wm_path);
+    wm_path = NULL;
+    if (font_nodes) g_ptr_array_free (font_nodes, TRUE);
+    font_nodes = NULL;
+
+    if (!xp_root) return;
+    xmlXPathFreeCompExpr (xp_root);
+    xmlXPathFreeCompExpr (xp_theme);
+    xmlXPathFreeCompExpr (xp_font);
+    for (val = 0; val < WM_N_VALUES; val++) xmlXPathFreeCompExpr (xp_values[val]);
+    xp_root = NULL;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,204 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+/* Times commits of a set of config files through the same path as apply_plan -
+ * a journal of the files, a write of each, then the journal closed - so that the
+ * cost of syncing can be compared before and after deferring it:
+ *
+ *   bench_commit [-n commits] [-f files] [-s bytes] [-u] [dir]
+ *
+ * Run it once as it is and once with PIPANEL_STRICT_SYNC=1 set, which syncs
+ * each write as it is made, as every write was before. With -u each commit
+ * writes the same contents again, showing the writes which are skipped. The
+ * files are made in a new directory inside dir, the current directory if none
+ * is given, as syncing costs nothing on a tmpfs */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "pipanel.h"
+#include "files.h"
+#include "journal.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+/* About the number and size of the files a preset writes */
+#define DEF_COMMITS 20
+#define DEF_FILES 16
+#define DEF_SIZE 2048
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static char *file_contents (int file, int commit, int size, gsize *len);
+static void remove_tree (const char *path);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+/* Used by recover_journal, which is linked in with the rest of journal.c */
+
+void check_directory (const char *path)
+{
+    char *dir = g_path_get_dirname (path);
+    g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+    g_free (dir);
+}
+
+/* A key file of about the size given, which differs for each commit */
+
+static char *file_contents (int file, int commit, int size, gsize *len)
+{
+    GString *str = g_string_new (NULL);
+    int i;
+
+    g_string_append_printf (str, "[bench]\nfile=%d\ncommit=%d\n", file, commit);
+    for (i = 0; str->len < (gsize) size; i++)
+        g_string_append_printf (str, "key%d=value %d of file %d\n", i, i, file);
+    *len = str->len;
+    return g_string_free (str, FALSE);
+}
+
+static void remove_tree (const char *path)
+{
+    GDir *dir = g_dir_open (path, 0, NULL);
+    const char *name;
+    char *file;
+
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)))
+        {
+            file = g_build_filename (path, name, NULL);
+            remove_tree (file);
+            g_free (file);
+        }
+        g_dir_close (dir);
+    }
+    g_remove (path);
+}
+
+int main (int argc, char *argv[])
+{
+    char **files, *base, *home, *path, *data;
+    gsize len;
+    gint64 start, elapsed;
+    unsigned int done, skipped, synced;
+    int commits = DEF_COMMITS, nfiles = DEF_FILES, size = DEF_SIZE, opt, c, i;
+    gboolean unchanged = FALSE;
+
+    while ((opt = getopt (argc, argv, "n:f:s:u")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n' :  commits = atoi (optarg);
+                        break;
+            case 'f' :  nfiles = atoi (optarg);
+                        break;
+            case 's' :  size = atoi (optarg);
+                        break;
+            case 'u' :  unchanged = TRUE;
+                        break;
+            default :   fprintf (stderr, "Usage: %s [-n commits] [-f files] [-s bytes] [-u] [dir]\n", argv[0]);
+                        return 1;
+        }
+    }
+    if (commits < 1 || nfiles < 1 || size < 1) return 1;
+
+    // the journal is kept under the home and cache directories, so both are moved
+    base = g_build_filename (optind < argc ? argv[optind] : ".", "pipanel-bench-XXXXXX", NULL);
+    home = g_mkdtemp (base);
+    if (!home)
+    {
+        fprintf (stderr, "Cannot create a directory in %s\n", optind < argc ? argv[optind] : ".");
+        return 1;
+    }
+    home = g_canonicalize_filename (home, NULL);
+    g_setenv ("HOME", home, TRUE);
+    path = g_build_filename (home, ".cache", NULL);
+    g_setenv ("XDG_CACHE_HOME", path, TRUE);
+    g_free (path);
+
+    files = g_new0 (char *, nfiles + 1);
+    for (i = 0; i < nfiles; i++)
+    {
+        files[i] = g_strdup_printf (".config/bench/file%d.conf", i);
+        path = g_build_filename (home, files[i], NULL);
+        check_directory (path);
+        data = file_contents (i, 0, size, &len);
+        g_file_set_contents (path, data, len, NULL);
+        g_free (data);
+        g_free (path);
+    }
+    sync ();
+
+    start = g_get_monotonic_time ();
+    for (c = 1; c <= commits; c++)
+    {
+        begin_journal (files);
+        for (i = 0; i < nfiles; i++)
+        {
+            path = g_build_filename (home, files[i], NULL);
+            data = file_contents (i, unchanged ? 0 : c, size, &len);
+            write_contents (path, data, len);
+            g_free (data);
+            g_free (path);
+        }
+        end_journal ();
+    }
+    elapsed = g_get_monotonic_time () - start;
+
+    write_counts (&done, &skipped, &synced);
+    printf ("%d commits of %d files of %d bytes%s\n", commits, nfiles, size, g_getenv ("PIPANEL_STRICT_SYNC") ? ", each write synced" : "");
+    printf ("%u written, %u unchanged, %u synced singly\n", done, skipped, synced);
+    printf ("%.2f ms per commit\n", elapsed / 1000.0 / commits);
+
+    remove_tree (home);
+    g_strfreev (files);
+    g_free (home);
+    g_free (base);
+    return 0;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,222 @@
+/*============================================================================
+Copyright (c) 2014-2025 Raspberry Pi
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+============================================================================*/
+
+/* Times setting the LibreOffice icon size in a large registry, by streaming it
+ * as save_libreoffice_settings now does, or through a DOM and XPath as it did
+ * before:
+ *
+ *   bench_registry [-m stream|dom] [-n items] [file]
+ *
+ * Without a file, a registrymodifications.xcu of the given number of items is
+ * made in the current directory - the default is about 10 MB. Run it once for
+ * each method; each run is a process of its own, so that the peak resident
+ * size it prints is for that method alone */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <libxml/xpath.h>
+
+#include "pipanel.h"
+#include "registry.h"
+
+/*----------------------------------------------------------------------------*/
+/* Typedefs and macros                                                        */
+/*----------------------------------------------------------------------------*/
+
+#define DEF_ITEMS 50000
+
+/*----------------------------------------------------------------------------*/
+/* Global data                                                                */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Prototypes                                                                 */
+/*----------------------------------------------------------------------------*/
+
+static gboolean make_registry (const char *path, int items);
+static void dom_settings (const char *in_file, const char *out_file, const char *value);
+
+/*----------------------------------------------------------------------------*/
+/* Function definitions                                                       */
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Helpers                                                                    */
+/*----------------------------------------------------------------------------*/
+
+/* A registry of recent documents, much as LibreOffice builds up, with the icon
+ * setting half way through */
+
+static gboolean make_registry (const char *path, int items)
+{
+    FILE *fp = fopen (path, "w");
+    int i;
+
+    if (!fp) return FALSE;
+    fprintf (fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<oor:items xmlns:xs=\"http://www.w3.org/2001/XMLSchema\" "
+        "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:oor=\"http://openoffice.org/2001/registry\">\n");
+    for (i = 0; i < items; i++)
+    {
+        if (i == items / 2)
+            fprintf (fp, "<item oor:path=\"/org.openoffice.Office.Common/Misc\"><prop oor:name=\"SymbolSet\" oor:op=\"fuse\">"
+                "<value>1</value></prop></item>\n");
+        fprintf (fp, "<item oor:path=\"/org.openoffice.Office.Histories/Histories/org.openoffice.Office.Histories:"
+            "HistoryInfo['PickList']/OrderList\"><node oor:name=\"%d\" oor:op=\"replace\"><prop oor:name=\"HistoryItemRef\" "
+            "oor:op=\"fuse\"><value>file:///home/pi/Documents/document%d.odt</value></prop></node></item>\n", i, i);
+    }
+    fprintf (fp, "</oor:items>\n");
+    return fclose (fp) == 0;
+}
+
+/* The method used before the registry was streamed */
+
+static void dom_settings (const char *in_file, const char *out_file, const char *value)
+{
+    xmlDocPtr xDoc;
+    xmlXPathContextPtr xpathCtx;
+    xmlXPathObjectPtr xpathObj;
+    xmlNodePtr rootnode, itemnode, propnode, valnode;
+    xmlChar *path, *name;
+    gboolean found = FALSE;
+
+    xmlInitParser ();
+    LIBXML_TEST_VERSION
+    xDoc = xmlParseFile (in_file);
+    if (!xDoc) xDoc = xmlNewDoc (XC ("1.0"));
+    xpathCtx = xmlXPathNewContext (xDoc);
+
+    xpathObj = xmlXPathEvalExpression (XC ("/*[name()='oor:items']"), xpathCtx);
+    if (xmlXPathNodeSetIsEmpty (xpathObj->nodesetval))
+    {
+        rootnode = xmlNewNode (NULL, XC ("oor:items"));
+        xmlDocSetRootElement (xDoc, rootnode);
+    }
+    else rootnode = xpathObj->nodesetval->nodeTab[0];
+
+    for (itemnode = rootnode->children; itemnode && !found; itemnode = itemnode->next)
+    {
+        if (itemnode->type != XML_ELEMENT_NODE || xmlStrcmp (itemnode->name, XC ("item"))) continue;
+        path = xmlGetProp (itemnode, XC ("path"));
+        propnode = itemnode->children;
+        if (!xmlStrcmp (path, XC ("/org.openoffice.Office.Common/Misc")) && propnode
+            && propnode->type == XML_ELEMENT_NODE && !xmlStrcmp (propnode->name, XC ("prop")))
+        {
+            name = xmlGetProp (propnode, XC ("name"));
+            if (!xmlStrcmp (name, XC ("SymbolSet")))
+            {
+                valnode = propnode->children;
+                if (valnode && valnode->type == XML_ELEMENT_NODE && !xmlStrcmp (valnode->name, XC ("value")))
+                    xmlNodeSetContent (valnode, XC (value));
+                found = TRUE;
+            }
+            xmlFree (name);
+        }
+        xmlFree (path);
+    }
+
+    if (!found)
+    {
+        itemnode = xmlNewNode (NULL, XC ("item"));
+        xmlSetProp (itemnode, XC ("oor:path"), XC ("/org.openoffice.Office.Common/Misc"));
+        propnode = xmlNewNode (NULL, XC ("prop"));
+        xmlSetProp (propnode, XC ("oor:name"), XC ("SymbolSet"));
+        xmlSetProp (propnode, XC ("oor:op"), XC ("fuse"));
+        xmlAddChild (itemnode, propnode);
+        valnode = xmlNewNode (NULL, XC ("value"));
+        xmlNodeSetContent (valnode, XC (value));
+        xmlAddChild (propnode, valnode);
+        xmlAddChild (rootnode, itemnode);
+    }
+
+    xmlXPathFreeObject (xpathObj);
+    xmlXPathFreeContext (xpathCtx);
+    xmlSaveFile (out_file, xDoc);
+    xmlFreeDoc (xDoc);
+}
+
+int main (int argc, char *argv[])
+{
+    struct rusage usage;
+    GStatBuf st;
+    const char *method = "stream";
+    char *in_file, *out_file;
+    gint64 start, elapsed;
+    int items = DEF_ITEMS, opt;
+    gboolean made = FALSE;
+
+    while ((opt = getopt (argc, argv, "m:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm' :  method = optarg;
+                        break;
+            case 'n' :  items = atoi (optarg);
+                        break;
+            default :   fprintf (stderr, "Usage: %s [-m stream|dom] [-n items] [file]\n", argv[0]);
+                        return 1;
+        }
+    }
+    if (strcmp (method, "stream") && strcmp (method, "dom")) return 1;
+
+    if (optind < argc) in_file = g_strdup (argv[optind]);
+    else
+    {
+        in_file = g_strdup ("registrymodifications.xcu");
+        if (!make_registry (in_file, items))
+        {
+            fprintf (stderr, "Cannot write %s\n", in_file);
+            return 1;
+        }
+        made = TRUE;
+    }
+    out_file = g_strdup_printf ("%s.%s", in_file, method);
+
+    start = g_get_monotonic_time ();
+    if (!strcmp (method, "stream")) write_libreoffice_settings (in_file, out_file, "3");
+    else dom_settings (in_file, out_file, "3");
+    elapsed = g_get_monotonic_time () - start;
+
+    getrusage (RUSAGE_SELF, &usage);
+    if (g_stat (in_file, &st) == 0) printf ("%s: %.1f MB registry\n", method, st.st_size / 1048576.0);
+    printf ("%s: %.1f ms, peak resident %ld kB\n", method, elapsed / 1000.0, usage.ru_maxrss);
+
+    // the output is left to compare with that of the other method
+    printf ("%s: written to %s\n", method, out_file);
+    if (made) g_remove (in_file);
+
+    g_free (out_file);
+    g_free (in_file);
+    return 0;
+}
+
+/* End of file */
+/*----------------------------------------------------------------------------*/